@@ -25,10 +25,10 @@
 #endif
 /* }}} */
 /* DECLARATIONS {{{ */
-static void ztie_usage();
-static void zuntie_usage();
-static void ztaddress_usage();
-static void ztclear_usage();
+static void ztie_usage(void);
+static void zuntie_usage(void);
+static void ztaddress_usage(void);
+static void ztclear_usage(void);
 
 static HashTable createhashtable(char *name);
 static void freebackendnode(HashNode hn);
@@ -58,9 +58,9 @@ static struct builtin bintab[] = {
                                   /* h - help, d - backend type, r - read-only, a/f - address/file,
                                    * l - load password from terminal, p - password as argument,
                                    * P - password from file, z - zero read-cache, D - delete on unset
-                                   * S - lazy mode will not even connect
+                                   * S - lazy mode will not even connect, o - backend-specific options
                                    */
-                                  BUILTIN("ztie", 0, bin_ztie, 0, -1, 0, "hrlzDSf:d:a:p:P:L:", NULL),
+                                  BUILTIN("ztie", 0, bin_ztie, 0, -1, 0, "hrlzDSf:d:a:p:P:L:o:", NULL),
                                   BUILTIN("zuntie", 0, bin_zuntie, 0, -1, 0, "uh", NULL),
                                   BUILTIN("ztaddress", 0, bin_ztaddress, 0, -1, 0, "h", NULL),
                                   BUILTIN("ztclear", 0, bin_ztclear, 0, -1, 0, "h", NULL),
@@ -148,7 +148,7 @@ static int
 bin_ztie(char *nam, char **args, Options ops, UNUSED(int func))
 {
     char *pmname;
-    char *address = NULL, *pass = NULL, *pfile = NULL, *lazy = NULL;
+    char *address = NULL, *pass = NULL, *pfile = NULL, *lazy = NULL, *opts = NULL;
     int flags = 0;
 
     /* Check options */
@@ -230,6 +230,11 @@ bin_ztie(char *nam, char **args, Options ops, UNUSED(int func))
         flags |= DB_FLAG_NOCONNECT;
     }
 
+    /* Backend-specific options */
+    if (OPT_ISSET(ops,'o')) {
+        opts = OPT_ARG(ops,'o');
+    }
+
     BackendNode node = NULL;
     DbBackendEntryPoint be = NULL;
 
@@ -244,7 +249,7 @@ bin_ztie(char *nam, char **args, Options ops, UNUSED(int func))
         return 1;
     }
 
-    return be(DB_TIE, flags, address, pass, pfile, pmname, lazy);
+    return be(DB_TIE, flags, address, pass, pfile, pmname, lazy, opts);
 }
 /* }}} */
 /* FUNCTION: bin_zuntie {{{ */
@@ -365,7 +370,7 @@ bin_ztclear(char *nam, char **args, Options ops, UNUSED(int func))
 /* FUNCTION: ztaddress_usage {{{ */
 
 static void
-ztaddress_usage()
+ztaddress_usage(void)
 {
     fprintf(stdout, "Usage: ztaddress {tied-parameter-name}\n");
     fprintf(stdout, "Description: stores address used by given parameter to $REPLY\n");
@@ -375,7 +380,7 @@ ztaddress_usage()
 /* FUNCTION: ztclear_usage {{{ */
 
 static void
-ztclear_usage()
+ztclear_usage(void)
 {
     fprintf(stdout, "Usage: ztclear {tied-parameter-name} [key name]\n");
     fprintf(stdout, "Description: clears cache of given hash/key or of given plain\n");
@@ -770,15 +775,16 @@ zsh_db_filter_arr(char ***arr, const char *input_s)
 /* FUNCTION: ztie_usage {{{ */
 
 static void
-ztie_usage()
+ztie_usage(void)
 {
-    fprintf(stdout, "Usage: ztie -d db/... [-z] [-r] [-p password] [-P password_file] [-L type]"
+    fprintf(stdout, "Usage: ztie -d db/... [-z] [-r] [-p password] [-P password_file] [-L type] [-o opts]"
             "-f/-a {db_address} {parameter_name}\n");
     fprintf(stdout, "Options for all backends:\n");
     fprintf(stdout, " -d:       select database type: \"db/gdbm\", \"db/redis\"\n");
     fprintf(stdout, " -z:       zero-cache for read operations (always access database)\n");
     fprintf(stdout, " -r:       create read-only parameter\n" );
     fprintf(stdout, " -f or -a: database-address in format {host}[:port][/[db_idx][/key]] or a file path\n");
+    fprintf(stdout, "           (Redis via unix socket: unix:{socket_path}[/[db_idx][/key]])\n");
     fprintf(stdout, "Options for db/redis backend:\n");
     fprintf(stdout, " -p:       database-password to be used for authentication\n");
     fprintf(stdout, " -P:       path to file with database-password\n");
@@ -786,6 +792,17 @@ ztie_usage()
                     "(string, set, zset, hash, list)\n");
     fprintf(stdout, " -S:       skip connecting to database in lazy binding\n");
     fprintf(stdout, " -D:       delete key on unset of the parameter ([/key] in the address has to be used)\n");
+    fprintf(stdout, " -o:       comma-separated list of tuning options, {name}[={value}],...:\n");
+    fprintf(stdout, "           batch={n} - number of elements sent in one bulk write command (default 1000)\n");
+    fprintf(stdout, "           diff - assignment sends only changes to cached contents, trusts the cache (hset, set, list)\n");
+    fprintf(stdout, "           rename - assignment builds collection under temporary key, then RENAMEs it\n");
+    fprintf(stdout, "           lua - assignment is done by server-side script (EVALSHA)\n");
+    fprintf(stdout, "           timeout={ms} - connect timeout (default 1500)\n");
+    fprintf(stdout, "           backoff={ms} - longest wait between reconnect attempts (default 30000)\n");
+    fprintf(stdout, "           track - server invalidates cached values (CLIENT TRACKING, Redis >= 6.0)\n");
+    fprintf(stdout, "           ttl={ms} - cached values are read again after given time\n");
+    fprintf(stdout, "           cache={n} - max. number of cached elements of a hash (least recently used are freed)\n");
+    fprintf(stdout, "           negcache={n} - number of remembered missing hash elements (default 1000, 0 disables)\n");
     fprintf(stdout, "\nThe {parameter_name} - choose name for the created database-bound parameter\n");
     fflush(stdout);
 }
@@ -793,7 +810,7 @@ ztie_usage()
 /* FUNCTION: zuntie_usage {{{ */
 
 static void
-zuntie_usage()
+zuntie_usage(void)
 {
     fprintf(stdout, "Usage: zuntie [-u] {tied-variable-name} [tied-variable-name] ...\n");
     fprintf(stdout, "Options:\n");
@@ -27,6 +27,26 @@
 #ifndef PM_UPTODATE
 #define PM_UPTODATE     (PM_LOADDIR) /* Parameter has up-to-date data (e.g. loaded from DB) */
 #endif
+#ifndef PM_RECENT
+#define PM_RECENT       (PM_SINGLE) /* Hash element accessed since last eviction pass (-o cache=) */
+#endif
+
+/* Default number of elements sent in one bulk write command */
+#define ZREDIS_DEFAULT_BATCH 1000
+
+/* Default number of missing hash elements remembered per tie */
+#define ZREDIS_DEFAULT_NEGCACHE 1000
+
+/* Milliseconds after which a temporary key of unfinished -o rename replace expires */
+#define ZREDIS_TMP_KEY_TTL 60000
+
+/* Connect timeout, in milliseconds */
+#define ZREDIS_DEFAULT_TIMEOUT 1500
+
+/* Wait after first failed reconnect, doubled on each next failure
+ * up to the limit (milliseconds); no reconnects are tried meanwhile */
+#define ZREDIS_BACKOFF_START 500
+#define ZREDIS_DEFAULT_BACKOFF 30000
 /* }}} */
 
 #if defined(HAVE_HIREDIS_HIREDIS_H) && defined(HAVE_REDISCONNECT)
@@ -39,15 +59,169 @@ static char *type_names[10] = { "none", "invalid", "no-key (main hash)", "string
 static Param createhash(char *name, int flags, int which);
 static void parse_host_string(const char *input, char *buffer, int size,
                                 char **host, int *port, int *db_index, char **key);
-static int connect(redisContext **rc, const char* password, const char *host, int port, int db_index, const char *address);
-static int type(redisContext **rc, int *fdesc, const char *redis_host_port, const char *password, char *key, size_t key_len);
+static int connect(redisContext **rc, const char* password, const char *host, int port, int db_index,
+                   const char *address, int timeout_ms);
 static int type_from_string(const char *string, int len);
 static int is_tied(Param pm);
-static int reconnect(redisContext **rc, int *fdesc, const char *hostspec, const char *password);
-static int auth(redisContext **rc, const char *password);
+static int reconnect_to(redisContext **rc, int *fdesc, const char *host, int port, int db_index,
+                        const char *password, const char *address, int timeout_ms);
 static int is_tied_cmd(char *pmname);
 static void deletehashparam(Param tied_param, const char *pmname);
 
+/*
+ * Tuning options given to ztie via -o, e.g.: -o batch=500
+ */
+struct tie_options {
+    int batch_size;     /* elements per bulk command (MSET, ...) */
+    int diff;           /* send only changes on whole-value assignment */
+    int rename;         /* replace collections via temporary key and RENAME */
+    int lua;            /* replace and purge with server-side scripts */
+    int timeout_ms;     /* connect timeout, 0 - not given */
+    int backoff_ms;     /* reconnect backoff limit, 0 - not given */
+    int track;          /* server-assisted cache invalidation */
+    int ttl_ms;         /* cached data expires after, 0 - never */
+    int cache_max;      /* max. element Params of a hash tie, 0 - no limit */
+    int negcache_max;   /* max. remembered missing elements, 0 - none */
+};
+
+static int tie_option_number(const char *name, const char *value, long min, const char *what, int *out);
+static int tie_option_flag(const char *name, const char *value, int *out);
+static int parse_tie_options(const char *spec, struct tie_options *topts);
+
+/*
+ * Connection shared by all tied parameters that use the same
+ * host, port, database index and password. Reference counted,
+ * reconnection repairs it for all the users at once. Untied
+ * parameter gets private, not pooled copy (see conn_detach).
+ */
+struct redis_conn {
+    redisContext *rc;
+    int fdesc;
+    int refs;
+    int pooled;
+    char *hostspec;     /* host:port/db or unix:path/db */
+    char *host;         /* host name or socket path */
+    int port;           /* -1 for unix socket */
+    int db_index;
+    char *password;
+    int scan_type;      /* SCAN ... TYPE support: 0 - unknown, 1 - yes, -1 - no */
+    int timeout_ms;     /* connect timeout */
+    int backoff_ms;     /* limit of the wait between reconnects */
+    int failures;       /* consecutive failed reconnects */
+    long long retry_after; /* no reconnect before this time (ms) */
+    pid_t pid;          /* process that owns rc (see conn_forked) */
+    redisContext *inval_rc; /* subscriber of invalidation messages (-o track) */
+    int inval_fdesc;
+    int tracking;       /* -1 - server doesn't support CLIENT TRACKING */
+    struct tracked_tie *tracked;
+    struct redis_conn *next;
+};
+
+/*
+ * Tie that gets its cache cleared by invalidation messages.
+ * `connp` is the address of the conn field of the tie's gsu
+ * ext – it identifies the tie in conn_detach.
+ */
+struct tracked_tie {
+    Param pm;
+    struct redis_conn **connp;
+    int type;
+    char *key;
+    size_t key_len;
+    struct tracked_tie *next;
+};
+
+static struct redis_conn *conn_pool = NULL;
+
+static struct redis_conn *conn_acquire(const char *host, int port, int db_index, const char *password,
+                                       const char *address, int do_connect,
+                                       const struct tie_options *topts);
+static void conn_release(struct redis_conn *conn);
+static void conn_detach(struct redis_conn **connp);
+static int conn_reconnect(struct redis_conn *conn);
+static int conn_forked(struct redis_conn *conn);
+static redisContext *conn_rc(struct redis_conn *conn);
+static void conn_track(Param pm);
+static int conn_track_start(struct redis_conn *conn);
+static void conn_track_stop(struct redis_conn *conn);
+static void conn_invalidate(struct redis_conn *conn, const char *key, size_t key_len);
+static void conn_poll_invalidations(struct redis_conn *conn);
+static void cache_expire(Param pm, HashTable ht, int ttl_ms, long long *expires);
+static int type(struct redis_conn *conn, char *key, size_t key_len);
+static long long now_ms(void);
+
+/*
+ * Argument vector for variadic commands (MSET key val key val ...).
+ * All arguments are owned, zalloc-ed copies. First `fixed`
+ * arguments (command name, key) survive rargv_flush(), the
+ * caller sets the field after adding them.
+ */
+struct redis_argv {
+    char **argv;
+    size_t *lens;
+    int argc;
+    int alloced;
+    int fixed;
+};
+
+static void rargv_init(struct redis_argv *ra);
+static void rargv_add(struct redis_argv *ra, const char *str, size_t len);
+static void rargv_add_meta(struct redis_argv *ra, const char *zstr);
+static int rargv_flush(redisContext *rc, struct redis_argv *ra);
+static void rargv_free(struct redis_argv *ra);
+static int drain_replies(redisContext *rc, int count, const char *cmdname);
+static int append_chunks(redisContext *rc, const char *cmd, const char *key, size_t key_len,
+                         char **vals, int batch_size);
+static void rargv_set(struct redis_argv *ra, int i, const char *str, size_t len);
+static int replace_members(redisContext *rc, const char *cmd, const char *key, size_t key_len,
+                           char **vals, int batch_size, const struct tie_options *topts);
+static int replace_via_rename(redisContext *rc, const char *cmd, const char *key, size_t key_len,
+                              char **vals, int batch_size);
+static int replace_via_script(redisContext *rc, const char *cmd, const char *key, size_t key_len,
+                              char **vals, int batch_size);
+static const char *script_sha(redisContext *rc, int script, int reload);
+static int apply_delta(redisContext *rc, const char *key, size_t key_len,
+                       const char *del_cmd, char **dels, const char *add_cmd, char **adds,
+                       int batch_size, const char *card_cmd, long long expected);
+static void mget_values(redisContext *rc, redisReply *keys, HashNode *nodes);
+static void visit_pairs(HashTable ht, redisReply *pairs, GetNodeFunc getnode, ScanFunc func, int flags);
+static redisReply *fetch_key(struct redis_conn *conn, const char *format, const char *key, size_t key_len);
+static redisReply *scan_string_keys(redisContext *rc, unsigned long long *cursor, int count,
+                                    int *scan_type, int filter, int pending, const char *pending_cmd);
+
+/*
+ * Server-side scripts of -o lua, called with EVALSHA. SHA1
+ * of a script depends only on its body, so it's obtained
+ * (SCRIPT LOAD) once and shared; a server that doesn't have
+ * the script (restarted, other instance) replies NOSCRIPT
+ * and EVAL is used then, which also loads the script.
+ */
+enum {
+    ZR_SCRIPT_REPLACE,          /* DEL + chunked variadic command */
+    ZR_SCRIPT_PURGE_STRINGS,    /* DEL of string keys given in ARGV */
+    ZR_SCRIPT_COUNT
+};
+
+/* unpack() is limited by Lua stack size, hence the steps */
+#define ZR_SCRIPT_MAX_STEP 4000
+
+static const char *zr_scripts[ZR_SCRIPT_COUNT] = {
+    "redis.call('DEL', KEYS[1]) "
+    "local step = tonumber(ARGV[2]) "
+    "for i = 3, #ARGV, step do "
+    "redis.call(ARGV[1], KEYS[1], unpack(ARGV, i, math.min(i + step - 1, #ARGV))) "
+    "end "
+    "return #ARGV - 2",
+
+    "local n = 0 "
+    "for _, k in ipairs(ARGV) do "
+    "if redis.call('TYPE', k).ok == 'string' then redis.call('DEL', k) n = n + 1 end "
+    "end "
+    "return n"
+};
+
+static char zr_script_sha[ZR_SCRIPT_COUNT][41];
+
 
 static char *my_nullarray = NULL;
 static int no_database_action = 0;
@@ -84,10 +258,14 @@ struct gsu_scalar_ext {
     char *redis_host_port;
     char *key;
     size_t key_len;
-    char *password;
-    int fdesc;
-    redisContext *rc;
+    struct redis_conn *conn;
     int unset_deletes;
+    struct tie_options opts;
+    long long cache_expires;    /* -o ttl: time of next cache sweep (ms) */
+    HashTable ht;               /* elements of hash ties, NULL for string */
+    int scanning;               /* no eviction while whole hash is scanned */
+    int neg_count;              /* elements marked missing (upper bound) */
+    int evict_hand;             /* bucket where eviction continues */
 };
 
 /* Used by sets */
@@ -99,12 +277,20 @@ struct gsu_array_ext {
     char *redis_host_port;
     char *key;
     size_t key_len;
-    char *password;
-    int fdesc;
-    redisContext *rc;
+    struct redis_conn *conn;
     int unset_deletes;
+    struct tie_options opts;
+    long long cache_expires;    /* -o ttl: time of next cache sweep (ms) */
+    char **win;                 /* zrlrange: cached window of a list */
+    long win_start;             /* index of its first element */
+    long win_llen;              /* length of the list when fetched */
+    long long win_sweep;        /* cache_expires when fetched */
 };
 
+static void list_window_drop(struct gsu_array_ext *gsu_ext);
+static void cache_evict(HashTable ht, struct gsu_scalar_ext *gsu_ext, HashNode keep);
+static void cache_missing(Param pm, struct gsu_scalar_ext *gsu_ext);
+
 /* Source structure - will be copied to allocated one,
  * with `rc` filled. `rc` allocation <-> gsu allocation. */
 static const struct gsu_scalar_ext hashel_gsu_ext =
@@ -147,19 +333,27 @@ static const struct gsu_array_ext arrlist_gsu_ext =
 static struct builtin bintab[] = {
     BUILTIN("zrzset", 0, bin_zrzset, 0, 1, 0, "h", NULL),
     BUILTIN("zrpush", 0, bin_zrpush, 0, -1, 0, "h", NULL),
+    BUILTIN("zrlrange", 0, bin_zrlrange, 0, 3, 0, "h", NULL),
 };
 /* }}} */
 /* ARRAY: other {{{ */
 #define ROARRPARAMDEF(name, var) \
     { name, PM_ARRAY | PM_READONLY, (void *) var, NULL,  NULL, NULL, NULL }
 
+#define ROINTPARAMDEF(name, var) \
+    { name, PM_INTEGER | PM_READONLY, (void *) var, NULL,  NULL, NULL, NULL }
+
 /* Holds names of all tied parameters */
 char **zredis_tied, *zredis_last;
 size_t zredis_last_size;
 
+/* Round trips saved by single-command reads (no EXISTS) */
+zlong zredis_saved_rtt;
+
 static struct paramdef patab[] = {
     ROARRPARAMDEF("zredis_tied", &zredis_tied),
     STRPARAMDEF("zredis_last", &zredis_last),
+    ROINTPARAMDEF("zredis_saved_rtt", &zredis_saved_rtt),
 };
 /* }}} */
 
@@ -169,6 +363,7 @@ redis_main_entry(VA_ALIST1(int cmd))
 VA_DCL
 {
     char *address = NULL, *pass = NULL, *pfile = NULL, *pmname = NULL, *key = NULL, *lazy = NULL;
+    char *opts = NULL;
     int flags = 0, rountie = 0;
 
     va_list ap;
@@ -186,6 +381,7 @@ VA_DCL
          * -P file with password, char *
          * parameter name, char *
          * -L lazy type, char *
+         * -o options, char *
          */
         flags = va_arg(ap, int);
         address = va_arg(ap, char *);
@@ -193,7 +389,8 @@ VA_DCL
         pfile = va_arg(ap, char *);
         pmname = va_arg(ap, char *);
         lazy = va_arg(ap, char *);
-        return zrtie_cmd(flags, address, pass, pfile, pmname, lazy);
+        opts = va_arg(ap, char *);
+        return zrtie_cmd(flags, address, pass, pfile, pmname, lazy, opts);
 
     case DB_UNTIE:
         /* Order is:
@@ -243,11 +440,13 @@ VA_DCL
 
 /**/
 static int
-zrtie_cmd(int flags, char *address, char *pass, char *pfile, char *pmname, char *lazy)
+zrtie_cmd(int flags, char *address, char *pass, char *pfile, char *pmname, char *lazy, char *opts)
 {
+    struct redis_conn *conn = NULL;
     redisContext *rc = NULL;
     int pmflags = PM_REMOVABLE;
     Param tied_param;
+    struct tie_options topts;
 
     if (!address) {
         zwarn("you must pass `-f' or '-a' with {host}[:port][/[db_idx][/key]], see `-h'", NULL);
@@ -263,6 +462,11 @@ zrtie_cmd(int flags, char *address, char *pass, char *pfile, char *pmname, char
         pmflags |= PM_READONLY;
     }
 
+    /* Parse -o options */
+    if (!parse_tie_options(opts, &topts)) {
+        return 1;
+    }
+
     /* Parse host data */
 
     char resource_name[192];
@@ -329,21 +533,20 @@ zrtie_cmd(int flags, char *address, char *pass, char *pfile, char *pmname, char
 
     /* Connect */
 
-    if (!lazy || (flags & DB_FLAG_NOCONNECT) == 0) {
-        if (!connect(&rc, pass, host, port, db_index, address)) {
-            return 1;
-        } else {
-            addmodulefd(rc->fd, FDT_INTERNAL);
-        }
-    }
+    /* Shared with other ties of the same host, port, db and
+     * password; lazy no-connect mode leaves conn->rc NULL */
+    conn = conn_acquire(host, port, db_index, pass, address,
+                        !lazy || (flags & DB_FLAG_NOCONNECT) == 0, &topts);
+    if (!conn)
+        return 1;
+    rc = conn->rc;
 
     /* Main string storage? */
     if (0 == strcmp(key,"")) {
         /* Create hash */
         if (!(tied_param = createhash(pmname, pmflags, 0))) {
             zwarn("cannot create the requested hash parameter: %s", pmname);
-            if (rc)
-                redisFree(rc);
+            conn_release(conn);
             return 1;
         }
 
@@ -354,8 +557,7 @@ zrtie_cmd(int flags, char *address, char *pass, char *pfile, char *pmname, char
         struct gsu_scalar_ext *rc_carrier = NULL;
         rc_carrier = (struct gsu_scalar_ext *) zshcalloc(sizeof(struct gsu_scalar_ext));
         if (!rc_carrier) {
-            if (rc)
-                redisFree(rc);
+            conn_release(conn);
             deletehashparam(tied_param, pmname);
             zwarn("Out of memory when allocating common data structure (1)");
             return 1;
@@ -371,44 +573,36 @@ zrtie_cmd(int flags, char *address, char *pass, char *pfile, char *pmname, char
             rc_carrier->is_lazy = 1;
         if (flags & DB_FLAG_DELETE)
             rc_carrier->unset_deletes = 1;
+        rc_carrier->opts = topts;
 
-        if (rc) {
-            rc_carrier->rc = rc;
-            rc_carrier->fdesc = rc->fd;
-        }
+        rc_carrier->conn = conn;
 
-        /* Fill also host:port// and password fields */
+        /* Fill also host:port// field */
         rc_carrier->redis_host_port = ztrdup(address);
-        if (pass)
-            rc_carrier->password = ztrdup(pass);
-        else
-            rc_carrier->password = NULL;
 
         tied_param->u.hash->tmpdata = (void *)rc_carrier;
+        rc_carrier->ht = tied_param->u.hash;
         tied_param->gsu.h = &redis_hash_gsu;
     } else {
-        int tpe, tpe2, dummy_fd = 0;
+        int tpe, tpe2;
         if (lazy) {
             tpe = type_from_string(lazy, strlen(lazy));
             if (rc) {
-                tpe2 = type(&rc, &dummy_fd, address, pass, key, (size_t) strlen(key));
+                tpe2 = type(conn, key, (size_t) strlen(key));
                 if (tpe != tpe2 && tpe2 != DB_KEY_TYPE_NONE) {
                     zwarn("Key `%s' already exists and is of type: `%s', aborting",
                         key, (tpe2 >= 0 && tpe2 <= 8) ? type_names[tpe2] : "error");
-                    if (rc) {
-                        redisFree(rc);
-                    }
+                    conn_release(conn);
                     return 1;
                 }
             }
         } else {
-            tpe = type(&rc, &dummy_fd, address, pass, key, (size_t) strlen(key));
+            tpe = type(conn, key, (size_t) strlen(key));
         }
         if (tpe == DB_KEY_TYPE_STRING) {
             if (!(tied_param = createparam(pmname, pmflags | PM_SPECIAL))) {
                 zwarn("cannot create the requested scalar parameter: %s", pmname);
-                if (rc)
-                    redisFree(rc);
+                conn_release(conn);
                 return 1;
             }
             struct gsu_scalar_ext *rc_carrier = NULL;
@@ -423,28 +617,21 @@ zrtie_cmd(int flags, char *address, char *pass, char *pfile, char *pmname, char
                 rc_carrier->is_lazy = 1;
             if (flags & DB_FLAG_DELETE)
                 rc_carrier->unset_deletes = 1;
+            rc_carrier->opts = topts;
 
-            if (rc) {
-                rc_carrier->rc = rc;
-                rc_carrier->fdesc = rc->fd;
-            }
+            rc_carrier->conn = conn;
 
             rc_carrier->key = ztrdup(key);
             rc_carrier->key_len = strlen(key);
 
-            /* Fill also host:port// and password fields */
+            /* Fill also host:port// field */
             rc_carrier->redis_host_port = ztrdup(address);
-            if (pass)
-                rc_carrier->password = ztrdup(pass);
-            else
-                rc_carrier->password = NULL;
 
             tied_param->gsu.s = (GsuScalar) rc_carrier;
         } else if (tpe == DB_KEY_TYPE_SET) {
             if (!(tied_param = createparam(pmname, pmflags | PM_ARRAY | PM_SPECIAL))) {
                 zwarn("cannot create the requested array (for set) parameter: %s", pmname);
-                if (rc)
-                    redisFree(rc);
+                conn_release(conn);
                 return 1;
             }
             struct gsu_array_ext *rc_carrier = NULL;
@@ -459,37 +646,29 @@ zrtie_cmd(int flags, char *address, char *pass, char *pfile, char *pmname, char
                 rc_carrier->is_lazy = 1;
             if (flags & DB_FLAG_DELETE)
                 rc_carrier->unset_deletes = 1;
+            rc_carrier->opts = topts;
 
-            if (rc) {
-                rc_carrier->rc = rc;
-                rc_carrier->fdesc = rc->fd;
-            }
+            rc_carrier->conn = conn;
 
             rc_carrier->key = ztrdup(key);
             rc_carrier->key_len = strlen(key);
 
-            /* Fill also host:port// and password fields */
+            /* Fill also host:port// field */
             rc_carrier->redis_host_port = ztrdup(address);
-            if (pass)
-                rc_carrier->password = ztrdup(pass);
-            else
-                rc_carrier->password = NULL;
 
             tied_param->gsu.s = (GsuScalar) rc_carrier;
         } else if (tpe == DB_KEY_TYPE_ZSET) {
             /* Create hash */
             if (!(tied_param = createhash(pmname, pmflags, 1))) {
                 zwarn("cannot create the requested hash (for zset) parameter: %s", pmname);
-                if (rc)
-                    redisFree(rc);
+                conn_release(conn);
                 return 1;
             }
 
             struct gsu_scalar_ext *rc_carrier = NULL;
             rc_carrier = (struct gsu_scalar_ext *) zshcalloc(sizeof(struct gsu_scalar_ext));
             if (!rc_carrier) {
-                if (rc)
-                    redisFree(rc);
+                conn_release(conn);
                 deletehashparam(tied_param, pmname);
                 zwarn("Out of memory when allocating common data structure (2)");
                 return 1;
@@ -505,38 +684,31 @@ zrtie_cmd(int flags, char *address, char *pass, char *pfile, char *pmname, char
                 rc_carrier->is_lazy = 1;
             if (flags & DB_FLAG_DELETE)
                 rc_carrier->unset_deletes = 1;
+            rc_carrier->opts = topts;
 
-            if (rc) {
-                rc_carrier->rc = rc;
-                rc_carrier->fdesc = rc->fd;
-            }
+            rc_carrier->conn = conn;
 
             rc_carrier->key = ztrdup(key);
             rc_carrier->key_len = strlen(key);
 
-            /* Fill also host:port// and password fields */
+            /* Fill also host:port// field */
             rc_carrier->redis_host_port = ztrdup(address);
-            if (pass)
-                rc_carrier->password = ztrdup(pass);
-            else
-                rc_carrier->password = NULL;
 
             tied_param->u.hash->tmpdata = (void *)rc_carrier;
+            rc_carrier->ht = tied_param->u.hash;
             tied_param->gsu.h = &hash_zset_gsu;
         } else if (tpe == DB_KEY_TYPE_HASH) {
             /* Create hash */
             if (!(tied_param = createhash(pmname, pmflags, 2))) {
                 zwarn("cannot create the requested hash (for hset) parameter: %s", pmname);
-                if (rc)
-                    redisFree(rc);
+                conn_release(conn);
                 return 1;
             }
 
             struct gsu_scalar_ext *rc_carrier = NULL;
             rc_carrier = (struct gsu_scalar_ext *) zshcalloc(sizeof(struct gsu_scalar_ext));
             if (!rc_carrier) {
-                if (rc)
-                    redisFree(rc);
+                conn_release(conn);
                 deletehashparam(tied_param, pmname);
                 zwarn("Out of memory when allocating common data structure (3)");
                 return 1;
@@ -552,29 +724,23 @@ zrtie_cmd(int flags, char *address, char *pass, char *pfile, char *pmname, char
                 rc_carrier->is_lazy = 1;
             if (flags & DB_FLAG_DELETE)
                 rc_carrier->unset_deletes = 1;
+            rc_carrier->opts = topts;
 
-            if (rc) {
-                rc_carrier->rc = rc;
-                rc_carrier->fdesc = rc->fd;
-            }
+            rc_carrier->conn = conn;
 
             rc_carrier->key = ztrdup(key);
             rc_carrier->key_len = strlen(key);
 
-            /* Fill also host:port// and password fields */
+            /* Fill also host:port// field */
             rc_carrier->redis_host_port = ztrdup(address);
-            if (pass)
-                rc_carrier->password = ztrdup(pass);
-            else
-                rc_carrier->password = NULL;
 
             tied_param->u.hash->tmpdata = (void *)rc_carrier;
+            rc_carrier->ht = tied_param->u.hash;
             tied_param->gsu.h = &hash_hset_gsu;
         } else if (tpe == DB_KEY_TYPE_LIST) {
             if (!(tied_param = createparam(pmname, pmflags | PM_ARRAY | PM_SPECIAL))) {
                 zwarn("cannot create the requested array (for list) parameter: %s", pmname);
-                if (rc)
-                    redisFree(rc);
+                conn_release(conn);
                 return 1;
             }
             struct gsu_array_ext *rc_carrier = NULL;
@@ -589,26 +755,19 @@ zrtie_cmd(int flags, char *address, char *pass, char *pfile, char *pmname, char
                 rc_carrier->is_lazy = 1;
             if (flags & DB_FLAG_DELETE)
                 rc_carrier->unset_deletes = 1;
+            rc_carrier->opts = topts;
 
-            if (rc) {
-                rc_carrier->rc = rc;
-                rc_carrier->fdesc = rc->fd;
-            }
+            rc_carrier->conn = conn;
 
             rc_carrier->key = ztrdup(key);
             rc_carrier->key_len = strlen(key);
 
-            /* Fill also host:port// and password fields */
+            /* Fill also host:port// field */
             rc_carrier->redis_host_port = ztrdup(address);
-            if (pass)
-                rc_carrier->password = ztrdup(pass);
-            else
-                rc_carrier->password = NULL;
 
             tied_param->gsu.s = (GsuScalar) rc_carrier;
         } else if (tpe == DB_KEY_TYPE_NONE) {
-            if (rc)
-                redisFree(rc);
+            conn_release(conn);
             if (lazy) {
                 zwarn("`none' disallowed as key-type, aborting");
             } else {
@@ -616,13 +775,16 @@ zrtie_cmd(int flags, char *address, char *pass, char *pfile, char *pmname, char
             }
             return 1;
         } else {
-            if (rc)
-                redisFree(rc);
+            conn_release(conn);
             zwarn("Unknown key type: %s", (tpe >= 0 && tpe <= 8) ? type_names[tpe] : "error");
             return 1;
         }
     }
 
+    /* Cache invalidated by the server */
+    if (topts.track)
+        conn_track(tied_param);
+
     /* Save in tied-enumeration array */
     zsh_db_arr_append(&zredis_tied, pmname);
 
@@ -861,6 +1023,7 @@ zredisclear_cmd(char *pmname, char *key)
         }
     } else if (pm->gsu.a->getfn == &redis_arrlist_getfn) {
         pm->node.flags &= ~(PM_UPTODATE);
+        list_window_drop((struct gsu_array_ext *) pm->gsu.a);
         if (key)
             zwarn("Ignored argument `%s'", key);
     } else {
@@ -882,8 +1045,11 @@ zredisclear_cmd(char *pmname, char *key)
  * might be not PM_UPTODATE - which means that database
  * wasn't yet queried.
  *
- * It will be left in this state if database doesn't
- * contain such key.
+ * If database doesn't contain such key, the param is
+ * marked as missing (PM_UPTODATE with NULL u.str, see
+ * cache_missing()), so that next reads don't query the
+ * server. The mark is cleared by local write, ztclear,
+ * -o ttl / -o track, or when -o negcache= is reached.
  */
 
 /**/
@@ -891,15 +1057,15 @@ static char *
 redis_getfn(Param pm)
 {
     struct gsu_scalar_ext *gsu_ext;
-    char *key, *umkey;
-    size_t key_len;
-    redisContext *rc;
-    redisReply *reply = NULL;
-    int retry, umlen;
+    char *umkey;
+    redisReply *reply;
+    int umlen;
 
     gsu_ext = (struct gsu_scalar_ext *) pm->gsu.s;
 
     /* Key already retrieved? */
+    conn_poll_invalidations(gsu_ext->conn);
+    cache_expire(pm, gsu_ext->ht, gsu_ext->opts.ttl_ms, &gsu_ext->cache_expires);
     if ((pm->node.flags & PM_UPTODATE) && gsu_ext->use_cache) {
         return pm->u.str ? pm->u.str : "";
     }
@@ -909,59 +1075,38 @@ redis_getfn(Param pm)
     umlen = 0;
     umkey = zsh_db_unmetafy_zalloc(pm->node.nam, &umlen);
 
-    key = umkey;
-    key_len = umlen;
-
-    retry = 0;
- retry:
-    rc = gsu_ext->rc;
-
-    if (rc) {
-        reply = redisCommand(rc, "EXISTS %b", key, (size_t) key_len);
-        if (reply && reply->type == REDIS_REPLY_INTEGER && reply->integer == 1) {
-            freeReplyObject(reply);
+    reply = fetch_key(gsu_ext->conn, "GET %b", umkey, (size_t) umlen);
 
-            reply = redisCommand(rc, "GET %b", key, (size_t) key_len);
-            if (reply && reply->type == REDIS_REPLY_STRING) {
-                /* We have data – store it, return it */
-                pm->node.flags |= PM_UPTODATE;
+    /* Free key, restoring its original length */
+    zsh_db_set_length(umkey, umlen);
+    zsfree(umkey);
 
-                /* Ensure there's no leak */
-                if (pm->u.str) {
-                    zsfree(pm->u.str);
-                    pm->u.str = NULL;
-                }
+    if (reply) {
+        /* We have data – store it, return it */
+        pm->node.flags |= PM_UPTODATE;
 
-                /* Metafy returned data. All fits - metafy
-                 * can obtain data length to avoid using \0 */
-                pm->u.str = metafy(reply->str, reply->len, META_DUP);
-                freeReplyObject(reply);
+        /* Ensure there's no leak */
+        if (pm->u.str) {
+            zsfree(pm->u.str);
+            pm->u.str = NULL;
+        }
 
-                /* Free key, restoring its original length */
-                zsh_db_set_length(umkey, key_len);
-                zsfree(umkey);
+        /* Metafy returned data. All fits - metafy
+         * can obtain data length to avoid using \0 */
+        pm->u.str = metafy(reply->str, reply->len, META_DUP);
+        freeReplyObject(reply);
 
-                /* Can return pointer, correctly saved inside hash */
-                return pm->u.str;
-            } else if (reply) {
-                freeReplyObject(reply);
-            }
-        } else if (reply) {
-            freeReplyObject(reply);
-        }
+        /* Can return pointer, correctly saved inside hash */
+        return pm->u.str;
     }
 
-    if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
-        retry = 1;
-        if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
-            goto retry;
-    } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
-        zwarn("Aborting (no connection)");
-    }
+    /* No connection (e.g. reconnect backoff) – last known value */
+    if (!gsu_ext->conn->rc && pm->u.str)
+        return pm->u.str;
 
-    /* Free key, restoring its original length */
-    zsh_db_set_length(umkey, key_len);
-    zsfree(umkey);
+    /* Database doesn't have the key */
+    if (gsu_ext->conn->rc && !gsu_ext->conn->rc->err)
+        cache_missing(pm, gsu_ext);
 
     return "";
 }
@@ -983,23 +1128,26 @@ redis_setfn(Param pm, char *val)
 
     /* Set is done on parameter and on database. */
 
-    /* Parameter */
+    /* Parameter – also drops the negative
+     * cache mark (PM_UPTODATE, NULL u.str) */
     if (pm->u.str) {
         zsfree(pm->u.str);
         pm->u.str = NULL;
-        pm->node.flags &= ~(PM_UPTODATE);
     }
+    pm->node.flags &= ~(PM_UPTODATE);
 
     if (val) {
         pm->u.str = ztrdup(val);
-        pm->node.flags |= PM_UPTODATE;
+        /* With -o track only what's read is tracked by the server */
+        if (!gsu_ext->opts.track)
+            pm->node.flags |= PM_UPTODATE;
     }
 
     retry = 0;
  retry:
 
     /* Database */
-    rc = gsu_ext->rc;
+    rc = conn_rc(gsu_ext->conn);
 
     /* Can be NULL, when calling unset after untie */
     if (no_database_action == 0) {
@@ -1037,7 +1185,7 @@ redis_setfn(Param pm, char *val)
 
         if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
             retry = 1;
-            if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+            if(conn_reconnect(gsu_ext->conn))
                 goto retry;
         } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
             zwarn("Aborting (no connection)");
@@ -1074,8 +1222,8 @@ redis_get_node(HashTable ht, const char *name)
      *
      * Add the Param to its hash, it is not PM_UPTODATE.
      * It will be loaded from database *and filled*
-     * or left in that state if the database doesn't
-     * contain it.
+     * or marked as missing (negative cache) if the
+     * database doesn't contain it.
      */
 
     if (!val_pm) {
@@ -1083,7 +1231,11 @@ redis_get_node(HashTable ht, const char *name)
         val_pm->node.flags = PM_SCALAR | PM_HASHELEM; /* no PM_UPTODATE */
         val_pm->gsu.s = (GsuScalar) ht->tmpdata;
         ht->addnode(ht, ztrdup(name), val_pm); // sets pm->node.nam
+
+        /* Keep within -o cache= limit */
+        cache_evict(ht, (struct gsu_scalar_ext *) ht->tmpdata, (HashNode) val_pm);
     }
+    val_pm->node.flags |= PM_RECENT;
 
     return (HashNode) val_pm;
 }
@@ -1093,6 +1245,21 @@ redis_get_node(HashTable ht, const char *name)
 /**/
 static void
 scan_keys(HashTable ht, ScanFunc func, int flags)
+{
+    struct gsu_scalar_ext *gsu_ext = (struct gsu_scalar_ext *) ht->tmpdata;
+
+    /* Scanned elements are referenced until the
+     * expansion ends – no eviction meanwhile */
+    gsu_ext->scanning ++;
+    scan_db_keys(ht, func, flags);
+    gsu_ext->scanning --;
+}
+/* }}} */
+/* FUNCTION: scan_db_keys {{{ */
+
+/**/
+static void
+scan_db_keys(HashTable ht, ScanFunc func, int flags)
 {
     char *key;
     size_t key_len, j;
@@ -1100,52 +1267,49 @@ scan_keys(HashTable ht, ScanFunc func, int flags)
     redisContext *rc;
     redisReply *reply = NULL, *reply2 = NULL;
     struct gsu_scalar_ext *gsu_ext;
+    HashNode *nodes;
 
     gsu_ext = (struct gsu_scalar_ext *)ht->tmpdata;
+    cache_expire(NULL, ht, gsu_ext->opts.ttl_ms, &gsu_ext->cache_expires);
 
     do {
         int retry = 0;
     retry:
-        rc = gsu_ext->rc;
+        rc = conn_rc(gsu_ext->conn);
 
         if (rc) {
-            /* Iterate keys adding them to hash, so
-            * we have Param to use in `func` */
-            reply = redisCommand(rc, "SCAN %llu", cursor);
+            /* Iterate string keys adding them to hash, so
+             * we have Param to use in `func`. The type is
+             * filtered server-side, or in one pipelined
+             * batch of TYPE commands per page */
+            reply = scan_string_keys(rc, &cursor, gsu_ext->opts.batch_size,
+                                     &gsu_ext->conn->scan_type, 1, 0, NULL);
         }
 
         /* Disconnect detection */
         if (!rc || rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)) {
             if (reply) {
                 freeReplyObject(reply);
+                reply = NULL;
             }
             if (retry) {
                 zwarn("Aborting (no connection)");
                 return;
             }
             retry = 1;
-            if (reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+            if (conn_reconnect(gsu_ext->conn))
                 goto retry;
             else
                 return;
         }
 
-        if (!reply || reply->type != REDIS_REPLY_ARRAY) {
-            zwarn("Incorrect reply from redis command SCAN, aborting");
-            if (reply)
-                freeReplyObject(reply);
+        /* Problem already reported */
+        if (!reply)
             return;
-        }
-
-        /* Get new cursor */
-        if (reply->element[0]->type == REDIS_REPLY_STRING) {
-            cursor = strtoull(reply->element[0]->str, NULL, 10);
-        } else {
-            zwarn("Error 14 occured during SCAN");
-            break;
-        }
 
         reply2 = reply->element[1];
+        nodes = (HashNode *) zshcalloc((reply2->elements + 1) * sizeof(HashNode));
+
         for (j = 0; j < reply2->elements; j++) {
             redisReply *entry = reply2->element[j];
             if (entry == NULL || entry->type != REDIS_REPLY_STRING) {
@@ -1155,27 +1319,102 @@ scan_keys(HashTable ht, ScanFunc func, int flags)
             key = entry->str;
             key_len = entry->len;
 
-            /* Only scan string keys, ignore the rest (hashes, sets, etc.) */
-            if (DB_KEY_TYPE_STRING != type(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password, key, (size_t) key_len)) {
-                rc = gsu_ext->rc;
-                continue;
-            }
-            rc = gsu_ext->rc;
-
             /* This returns database-interfacing Param,
              * it will return u.str or first fetch data
              * if not PM_UPTODATE (newly created) */
             char *zkey = metafy(key, key_len, META_DUP);
-            HashNode hn = redis_get_node(ht, zkey);
+            nodes[j] = redis_get_node(ht, zkey);
             zsfree(zkey);
+        }
+
+        /* Values are wanted – fetch whole page at once */
+        if (gsu_ext->use_cache && (flags & (SCANPM_WANTVALS | SCANPM_MATCHVAL)))
+            mget_values(rc, reply2, nodes);
 
-            func(hn, flags);
+        for (j = 0; j < reply2->elements; j++) {
+            if (nodes[j])
+                func(nodes[j], flags);
         }
 
+        zfree(nodes, (reply2->elements + 1) * sizeof(HashNode));
         freeReplyObject(reply);
+        reply = NULL;
     } while (cursor != 0);
 }
 /* }}} */
+/* FUNCTION: cache_elem_value {{{ */
+
+/*
+ * Stores value obtained as a side effect of other
+ * query (MGET, HSCAN, ...) into element Param and
+ * marks it PM_UPTODATE, so that getfn will not ask
+ * the database again
+ */
+
+/**/
+static void
+cache_elem_value(Param pm, const char *str, size_t len)
+{
+    /* Ensure there's no leak */
+    if (pm->u.str) {
+        zsfree(pm->u.str);
+        pm->u.str = NULL;
+    }
+
+    /* Metafy returned data. All fits - metafy
+     * can obtain data length to avoid using \0 */
+    pm->u.str = metafy((char *) str, len, META_DUP);
+    pm->node.flags |= PM_UPTODATE;
+}
+/* }}} */
+/* FUNCTION: mget_values {{{ */
+
+/*
+ * Fills not yet PM_UPTODATE Params of a SCAN page (`keys`,
+ * `nodes` – the Params, at the same indices) with a single
+ * MGET. Keys that vanished in the meantime are left as they
+ * are, the getter will query them.
+ */
+
+static void
+mget_values(redisContext *rc, redisReply *keys, HashNode *nodes)
+{
+    struct redis_argv ra;
+    redisReply *reply = NULL, *value;
+    size_t j, k;
+
+    rargv_init(&ra);
+    rargv_add(&ra, "MGET", 4);
+    ra.fixed = ra.argc;
+
+    for (j = 0; j < keys->elements; j++) {
+        if (nodes[j] && (!(((Param) nodes[j])->node.flags & PM_UPTODATE) || !((Param) nodes[j])->u.str))
+            rargv_add(&ra, keys->element[j]->str, keys->element[j]->len);
+    }
+
+    if (ra.argc > ra.fixed) {
+        reply = redisCommandArgv(rc, ra.argc, (const char **) ra.argv, ra.lens);
+    }
+
+    if (reply && reply->type == REDIS_REPLY_ARRAY && reply->elements == (size_t) (ra.argc - ra.fixed)) {
+        for (j = 0, k = 0; j < keys->elements; j++) {
+            Param pm = (Param) nodes[j];
+            if (!pm || ((pm->node.flags & PM_UPTODATE) && pm->u.str))
+                continue;
+
+            value = reply->element[k++];
+            if (value == NULL || value->type != REDIS_REPLY_STRING)
+                continue;
+
+            cache_elem_value(pm, value->str, value->len);
+        }
+    }
+
+    if (reply)
+        freeReplyObject(reply);
+    rargv_free(&ra);
+}
+/* }}} */
 /* FUNCTION: redis_hash_setfn {{{ */
 
 /*
@@ -1188,8 +1427,6 @@ redis_hash_setfn(Param pm, HashTable ht)
 {
     size_t i, j;
     HashNode hn;
-    char *key, *content;
-    size_t key_len, content_len;
     redisContext *rc;
     redisReply *reply = NULL, *entry = NULL, *reply2 = NULL;
     struct gsu_scalar_ext *gsu_ext;
@@ -1202,52 +1439,77 @@ redis_hash_setfn(Param pm, HashTable ht)
 
     retry = 0;
  retry:
-    rc = gsu_ext->rc;
+    rc = conn_rc(gsu_ext->conn);
 
     if (rc) {
-        /* KEYS */
-        reply = redisCommand(rc, "KEYS *");
-        if (reply == NULL || reply->type != REDIS_REPLY_ARRAY) {
-            if (reply)
-                freeReplyObject(reply);
-            goto do_retry;
-        }
+        /* Purge string keys page by page, removal of
+         * one page is pipelined with SCAN of the next */
+        struct redis_argv ra;
+        unsigned long long cursor = 0;
+        int pending = 0;
+        const char *delcmd = "DEL", *sha = NULL;
+
+        /* Server without SCAN TYPE (or not yet known) – with
+         * -o lua the purge script checks the types, instead
+         * of a round of TYPE commands. It's (re)loaded to be
+         * sure that the pipelined EVALSHA calls will not get
+         * NOSCRIPT */
+        if (gsu_ext->opts.lua && gsu_ext->conn->scan_type <= 0)
+            sha = script_sha(rc, ZR_SCRIPT_PURGE_STRINGS, 1);
+
+        rargv_init(&ra);
+
+        do {
+            queue_signals();
 
-        for (j = 0; j < reply->elements; j++) {
-            entry = reply->element[j];
-            if (entry == NULL || entry->type != REDIS_REPLY_STRING) {
-                continue;
+            reply = scan_string_keys(rc, &cursor, gsu_ext->opts.batch_size,
+                                     &gsu_ext->conn->scan_type, !sha, pending, delcmd);
+            pending = 0;
+            if (!reply) {
+                unqueue_signals();
+                break;
             }
-            key = entry->str;
-            key_len = entry->len;
 
-            /* Only scan string keys, ignore the rest (hashes, sets, etc.) */
-            if (DB_KEY_TYPE_STRING != type(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password, key, (size_t) key_len)) {
-                rc = gsu_ext->rc;
-                continue;
+            /* UNLINK frees memory in background, it's
+             * there on every server that has SCAN TYPE */
+            if (!ra.fixed) {
+                delcmd = gsu_ext->conn->scan_type > 0 ? "UNLINK" : "DEL";
+
+                if (gsu_ext->conn->scan_type < 0 && sha) {
+                    delcmd = "EVALSHA";
+                    rargv_add(&ra, delcmd, strlen(delcmd));
+                    rargv_add(&ra, sha, 40);
+                    rargv_add(&ra, "0", 1);
+                } else {
+                    rargv_add(&ra, delcmd, strlen(delcmd));
+                }
+                ra.fixed = ra.argc;
             }
-            rc = gsu_ext->rc;
-
-            queue_signals();
 
-            /* DEL */
-            reply2 = redisCommand(rc, "DEL %b", key, (size_t) key_len);
-            if (reply2) {
-                freeReplyObject(reply2);
-                reply2 = NULL;
+            reply2 = reply->element[1];
+            for (j = 0; j < reply2->elements; j++) {
+                entry = reply2->element[j];
+                if (entry == NULL || entry->type != REDIS_REPLY_STRING) {
+                    continue;
+                }
+                rargv_add(&ra, entry->str, entry->len);
             }
-            if (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF))
-                break;
+            freeReplyObject(reply);
+            reply = NULL;
+
+            pending = rargv_flush(rc, &ra);
 
             unqueue_signals();
-        }
-        freeReplyObject(reply);
+        } while (cursor != 0);
+
+        if (pending && !(rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))
+            drain_replies(rc, pending, delcmd);
+        rargv_free(&ra);
     }
 
- do_retry:
     if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
         retry = 1;
-        if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+        if(conn_reconnect(gsu_ext->conn))
             goto retry;
         else
             return;
@@ -1264,58 +1526,59 @@ redis_hash_setfn(Param pm, HashTable ht)
         return;
 
      /* Put new strings into database, having
-      * their interfacing-Params created */
+      * their interfacing-Params created. Keys are
+      * sent in chunks of MSET, one reply per chunk */
 
     retry = 0;
  retry2:
-    rc = gsu_ext->rc;
+    rc = conn_rc(gsu_ext->conn);
 
     if (rc) {
-        for (i = 0; i < ht->hsize; i++) {
+        struct redis_argv ra;
+        int pairs = 0;
+
+        rargv_init(&ra);
+        rargv_add(&ra, "MSET", 4);
+        ra.fixed = ra.argc;
+
+        for (i = 0; i < ht->hsize && !(rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)); i++) {
             for (hn = ht->nodes[i]; hn; hn = hn->next) {
                 struct value v;
-                int umlen;
-                char *umkey, *umval;
 
                 v.isarr = v.flags = v.start = 0;
                 v.end = -1;
                 v.arr = NULL;
                 v.pm = (Param) hn;
 
-                /* Unmetafy key */
-                umlen = 0;
-                umkey = zsh_db_unmetafy_zalloc(v.pm->node.nam, &umlen);
-
-                key = umkey;
-                key_len = umlen;
-
                 queue_signals();
 
-                /* Unmetafy data */
-                umval = zsh_db_unmetafy_zalloc(getstrvalue(&v), &umlen);
-
-                content = umval;
-                content_len = umlen;
-
-                /* SET */
-                reply = redisCommand(rc, "SET %b %b", key, (size_t) key_len, content, (size_t) content_len);
-                if (reply)
-                    freeReplyObject(reply);
+                /* Unmetafied key and data */
+                rargv_add_meta(&ra, v.pm->node.nam);
+                rargv_add_meta(&ra, getstrvalue(&v));
 
-                /* Free, restoring original length */
-                zsh_db_set_length(umval, content_len);
-                zsfree(umval);
-                zsh_db_set_length(umkey, key_len);
-                zsfree(umkey);
+                /* Full chunk – send it */
+                if (++ pairs >= gsu_ext->opts.batch_size) {
+                    drain_replies(rc, rargv_flush(rc, &ra), "MSET");
+                    pairs = 0;
+                }
 
                 unqueue_signals();
+
+                if (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF))
+                    break;
             }
         }
 
+        /* Remaining, partial chunk */
+        if (pairs && !(rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF))) {
+            drain_replies(rc, rargv_flush(rc, &ra), "MSET");
+        }
+        rargv_free(&ra);
+
         /* Disconnect detection */
         if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
             retry = 1;
-            if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+            if(conn_reconnect(gsu_ext->conn))
                 goto retry2;
         } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
             zwarn("Aborting (no connection)");
@@ -1348,8 +1611,7 @@ redis_hash_unsetfn(Param pm, UNUSED(int exp))
     /* Don't need custom GSU structure with its
      * redisContext pointer anymore */
     zsfree(gsu_ext->redis_host_port);
-    if (gsu_ext->password)
-        zsfree(gsu_ext->password);
+    conn_release(gsu_ext->conn);
     zfree(gsu_ext, sizeof(struct gsu_scalar_ext));
 
     pm->node.flags |= PM_UNSET;
@@ -1362,16 +1624,11 @@ static void
 redis_hash_untie(Param pm)
 {
     struct gsu_scalar_ext *gsu_ext = (struct gsu_scalar_ext *)pm->u.hash->tmpdata;
-    redisContext *rc = gsu_ext->rc;
     HashTable ht = pm->u.hash;
 
-    if (rc) { /* <- paranoia ... actually not! used by the new no-connect lazy mode */
-        redisFree(rc);
-        fdtable[gsu_ext->fdesc] = FDT_UNUSED;
-
-        /* Let hash fields know there's no backend */
-        ((struct gsu_scalar_ext *)ht->tmpdata)->rc = NULL;
-    }
+    /* Release the shared connection, hash fields
+     * will know there's no backend (rc is NULL) */
+    conn_detach(&gsu_ext->conn);
 
     /* Remove from list of tied parameters */
     zsh_db_filter_arr(&zredis_tied, pm->node.nam);
@@ -1394,68 +1651,45 @@ static char *
 redis_str_getfn(Param pm)
 {
     struct gsu_scalar_ext *gsu_ext;
-    char *key;
-    size_t key_len;
-    redisContext *rc;
-    redisReply *reply = NULL;
-    int retry;
+    redisReply *reply;
 
     gsu_ext = (struct gsu_scalar_ext *) pm->gsu.s;
     /* Key already retrieved? */
+    conn_poll_invalidations(gsu_ext->conn);
+    cache_expire(pm, gsu_ext->ht, gsu_ext->opts.ttl_ms, &gsu_ext->cache_expires);
     if ((pm->node.flags & PM_UPTODATE) && gsu_ext->use_cache) {
         return pm->u.str ? pm->u.str : "";
     }
 
-    key = gsu_ext->key;
-    key_len = gsu_ext->key_len;
+    reply = fetch_key(gsu_ext->conn, "GET %b", gsu_ext->key, gsu_ext->key_len);
 
-    retry = 0;
- retry:
-    rc = gsu_ext->rc;
+    if (reply) {
+        /* We have data – store it and return it */
+        pm->node.flags |= PM_UPTODATE;
 
-    if (rc) {
-        reply = redisCommand(rc, "EXISTS %b", key, (size_t) key_len);
-        if (reply && reply->type == REDIS_REPLY_INTEGER && reply->integer == 1) {
-            freeReplyObject(reply);
+        /* Ensure there's no leak */
+        if (pm->u.str) {
+            zsfree(pm->u.str);
+            pm->u.str = NULL;
+        }
 
-            reply = redisCommand(rc, "GET %b", key, (size_t) key_len);
-            if (reply && reply->type == REDIS_REPLY_STRING) {
-                /* We have data – store it and return it */
-                pm->node.flags |= PM_UPTODATE;
+        /* Metafy returned data. All fits - metafy
+         * can obtain data length to avoid using \0 */
+        pm->u.str = metafy(reply->str, reply->len, META_DUP);
+        freeReplyObject(reply);
 
-                /* Ensure there's no leak */
-                if (pm->u.str) {
-                    zsfree(pm->u.str);
-                    pm->u.str = NULL;
-                }
+        /* Can return pointer, correctly saved inside Param */
+        return pm->u.str;
+    }
 
-                /* Metafy returned data. All fits - metafy
-                * can obtain data length to avoid using \0 */
-                pm->u.str = metafy(reply->str, reply->len, META_DUP);
-                freeReplyObject(reply);
+    /* No connection (e.g. reconnect backoff) – last known value */
+    if (!gsu_ext->conn->rc && pm->u.str)
+        return pm->u.str;
 
-                /* Can return pointer, correctly saved inside Param */
-                return pm->u.str;
-            } else if (reply) {
-                freeReplyObject(reply);
-            }
-        } else if (reply) {
-            freeReplyObject(reply);
-        }
-    }
-
-    if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
-        retry = 1;
-        if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
-            goto retry;
-    } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
-        zwarn("Aborting (no connection)");
-    }
-
-    return "";
-}
-/* }}} */
-/* FUNCTION: redis_str_setfn {{{ */
+    return "";
+}
+/* }}} */
+/* FUNCTION: redis_str_setfn {{{ */
 
 /**/
 static void
@@ -1468,28 +1702,32 @@ redis_str_setfn(Param pm, char *val)
     struct gsu_scalar_ext *gsu_ext;
     int retry;
 
+    gsu_ext = (struct gsu_scalar_ext *) pm->gsu.s;
+
     /* Set is done on parameter and on database. */
 
-    /* Parameter */
+    /* Parameter – also drops the negative
+     * cache mark (PM_UPTODATE, NULL u.str) */
     if (pm->u.str) {
         zsfree(pm->u.str);
         pm->u.str = NULL;
-        pm->node.flags &= ~(PM_UPTODATE);
     }
+    pm->node.flags &= ~(PM_UPTODATE);
 
     if (val) {
         pm->u.str = ztrdup(val);
-        pm->node.flags |= PM_UPTODATE;
+        /* With -o track only what's read is tracked by the server */
+        if (!gsu_ext->opts.track)
+            pm->node.flags |= PM_UPTODATE;
     }
 
     /* Database */
-    gsu_ext = (struct gsu_scalar_ext *) pm->gsu.s;
     key = gsu_ext->key;
     key_len = gsu_ext->key_len;
 
     retry = 0;
  retry:
-    rc = gsu_ext->rc;
+    rc = conn_rc(gsu_ext->conn);
 
     if (rc) {
         if (val) {
@@ -1517,7 +1755,7 @@ redis_str_setfn(Param pm, char *val)
     if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
         retry = 1;
         if (val || !yes_unsetting || gsu_ext->unset_deletes) {
-            if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+            if(conn_reconnect(gsu_ext->conn))
                 goto retry;
         }
     } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
@@ -1550,11 +1788,8 @@ redis_str_untie(Param pm)
 {
     struct gsu_scalar_ext *gsu_ext = (struct gsu_scalar_ext *) pm->gsu.s;
 
-    if (gsu_ext->rc) { /* <- paranoia ... actually not! used by the new no-connect lazy mode */
-        redisFree(gsu_ext->rc);
-        gsu_ext->rc = NULL;
-        fdtable[gsu_ext->fdesc] = FDT_UNUSED;
-    }
+    /* Release the shared connection */
+    conn_detach(&gsu_ext->conn);
 
     /* Remove from list of tied parameters */
     zsh_db_filter_arr(&zredis_tied, pm->node.nam);
@@ -1564,8 +1799,7 @@ redis_str_untie(Param pm)
 
     /* Free gsu_ext */
     zsfree(gsu_ext->redis_host_port);
-    if (gsu_ext->password)
-        zsfree(gsu_ext->password);
+    conn_release(gsu_ext->conn);
     zsfree(gsu_ext->key);
     zfree(gsu_ext, sizeof(struct gsu_scalar_ext));
 }
@@ -1580,96 +1814,63 @@ char **
 redis_arrset_getfn(Param pm)
 {
     struct gsu_array_ext *gsu_ext;
-    char *key;
-    size_t key_len;
-    redisContext *rc;
-    redisReply *reply = NULL;
-    int j, retry;
+    redisReply *reply;
+    int j;
 
     gsu_ext = (struct gsu_array_ext *) pm->gsu.a;
     /* Key already retrieved? */
+    conn_poll_invalidations(gsu_ext->conn);
+    cache_expire(pm, NULL, gsu_ext->opts.ttl_ms, &gsu_ext->cache_expires);
     if ((pm->node.flags & PM_UPTODATE) && gsu_ext->use_cache) {
         return pm->u.arr ? pm->u.arr : &my_nullarray;
     }
 
-    key = gsu_ext->key;
-    key_len = gsu_ext->key_len;
-
-    retry = 0;
- retry:
-    rc = gsu_ext->rc;
+    reply = fetch_key(gsu_ext->conn, "SMEMBERS %b", gsu_ext->key, gsu_ext->key_len);
 
-    if (rc) {
-        reply = redisCommand(rc, "EXISTS %b", key, (size_t) key_len);
-        if (reply && reply->type == REDIS_REPLY_INTEGER && reply->integer == 1) {
-            freeReplyObject(reply);
-            reply = NULL;
+    if (reply) {
+        /* We have data – store it and return it */
+        pm->node.flags |= PM_UPTODATE;
 
-            reply = redisCommand(rc, "SMEMBERS %b", key, (size_t) key_len);
-            if (reply && reply->type == REDIS_REPLY_ARRAY) {
-                /* We have data – store it and return it */
-                pm->node.flags |= PM_UPTODATE;
+        /* Ensure there's no leak */
+        if (pm->u.arr) {
+            freearray(pm->u.arr);
+            pm->u.arr = NULL;
+        }
 
-                /* Ensure there's no leak */
-                if (pm->u.arr) {
-                    freearray(pm->u.arr);
-                    pm->u.arr = NULL;
-                }
+        pm->u.arr = zalloc((reply->elements + 1) * sizeof(char*));
 
-                pm->u.arr = zalloc((reply->elements + 1) * sizeof(char*));
-
-                for (j = 0; j < reply->elements; j++) {
-                    if (NULL == reply->element[j]) {
-                        pm->u.arr[j] = ztrdup("");
-                        zwarn("Error 10 when fetching set elements");
-                        continue;
-                    } else if (reply->element[j]->type != REDIS_REPLY_STRING) {
-                        pm->u.arr[j] = ztrdup("");
-                        if (NULL != reply->element[j]->str && reply->element[j]->len > 0) {
-                            zwarn("Error 11 when fetching set elements (message: %s)", reply->element[j]->str);
-                        } else {
-                            zwarn("Error 11 when fetching set elements");
-                        }
-                        continue;
-                    }
-                    /* Metafy returned data. All fits - metafy
-                    * can obtain data length to avoid using \0 */
-                    pm->u.arr[j] = metafy(reply->element[j]->str,
-                                        reply->element[j]->len,
-                                        META_DUP);
+        for (j = 0; j < reply->elements; j++) {
+            if (NULL == reply->element[j]) {
+                pm->u.arr[j] = ztrdup("");
+                zwarn("Error 10 when fetching set elements");
+                continue;
+            } else if (reply->element[j]->type != REDIS_REPLY_STRING) {
+                pm->u.arr[j] = ztrdup("");
+                if (NULL != reply->element[j]->str && reply->element[j]->len > 0) {
+                    zwarn("Error 11 when fetching set elements (message: %s)", reply->element[j]->str);
+                } else {
+                    zwarn("Error 11 when fetching set elements");
                 }
-                pm->u.arr[reply->elements] = NULL;
-
-                freeReplyObject(reply);
-                reply = NULL;
-
-                /* Can return pointer, correctly saved inside Param */
-                return pm->u.arr;
-            } else if (reply) {
-                freeReplyObject(reply);
-                reply = NULL;
+                continue;
             }
-        } else if (reply) {
-            freeReplyObject(reply);
-            reply = NULL;
+            /* Metafy returned data. All fits - metafy
+            * can obtain data length to avoid using \0 */
+            pm->u.arr[j] = metafy(reply->element[j]->str,
+                                reply->element[j]->len,
+                                META_DUP);
         }
-    }
+        pm->u.arr[reply->elements] = NULL;
 
-    /* Disconnect detection */
-    if (!rc || rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)) {
-        if (reply) {
-            freeReplyObject(reply);
-            reply = NULL;
-        }
-        if (retry) {
-            zwarn("Aborting (no connection)");
-            return &my_nullarray;
-        }
-        retry = 1;
-        if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
-            goto retry;
+        freeReplyObject(reply);
+
+        /* Can return pointer, correctly saved inside Param */
+        return pm->u.arr;
     }
 
+    /* No connection (e.g. reconnect backoff) – last known value */
+    if (!gsu_ext->conn->rc && pm->u.arr)
+        return pm->u.arr;
+
     /* Array with 0 elements */
     return &my_nullarray;
 }
@@ -1680,13 +1881,28 @@ redis_arrset_getfn(Param pm)
 void
 redis_arrset_setfn(Param pm, char **val)
 {
-    char *key, *content;
-    size_t key_len, content_len;
-    int alen = 0, j;
+    char *key, **dels = NULL, **adds = NULL;
+    size_t key_len;
     redisContext *rc;
     redisReply *reply = NULL;
     struct gsu_array_ext *gsu_ext;
 
+    gsu_ext = (struct gsu_array_ext *) pm->gsu.a;
+
+    /* Diff mode – compute SREM/SADD deltas from the
+     * cached members, before they're freed below; only
+     * from the ones not invalidated and not expired */
+    if (val && pm->u.arr && pm->u.arr != val && gsu_ext->opts.diff && gsu_ext->use_cache) {
+        conn_poll_invalidations(gsu_ext->conn);
+        cache_expire(pm, NULL, gsu_ext->opts.ttl_ms, &gsu_ext->cache_expires);
+    }
+    if (val && pm->u.arr && pm->u.arr != val && gsu_ext->opts.diff &&
+        gsu_ext->use_cache && (pm->node.flags & PM_UPTODATE))
+    {
+        uniqarray(val);
+        array_delta(pm->u.arr, val, &dels, &adds);
+    }
+
     /* Set is done on parameter and on database. */
 
     /* Parameter */
@@ -1698,13 +1914,13 @@ redis_arrset_setfn(Param pm, char **val)
 
     if (val) {
         uniqarray(val);
-        alen = arrlen(val);
         pm->u.arr = val;
-        pm->node.flags |= PM_UPTODATE;
+        /* With -o track only what's read is tracked by the server */
+        if (!gsu_ext->opts.track)
+            pm->node.flags |= PM_UPTODATE;
     }
 
     /* Database */
-    gsu_ext = (struct gsu_array_ext *) pm->gsu.a;
     key = gsu_ext->key;
     key_len = gsu_ext->key_len;
 
@@ -1714,48 +1930,22 @@ redis_arrset_setfn(Param pm, char **val)
 
     int retry = 0;
 retry:
-    rc = gsu_ext->rc;
+    rc = conn_rc(gsu_ext->conn);
     if (rc) {
-        reply = redisCommand(rc, "DEL %b", key, (size_t) key_len);
-        if (reply) {
-            freeReplyObject(reply);
-            reply = NULL;
-        }
-
-        /* Disconnect detection */
-        if (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)) {
-            if (retry) {
-                zwarn("Aborting (no connection)");
-                return;
-            }
-            retry = 1;
-            if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
-                goto retry;
-            else
-                return;
-        }
-
         if (val) {
-            for (j=0; j<alen; j ++) {
-                /* Unmetafy with exact zalloc size */
-                int umlen = 0;
-                char *umval = zsh_db_unmetafy_zalloc(val[j], &umlen);
-
-                /* Store */
-                content = umval;
-                content_len = umlen;
-                reply = redisCommand(rc, "SADD %b %b", key, (size_t) key_len, content, (size_t) content_len);
-                if (reply) {
-                    freeReplyObject(reply);
-                    reply = NULL;
-                }
-                if (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)) {
-                    break;
-                }
-
-                /* Free */
-                zsh_db_set_length(umval, umlen);
-                zsfree(umval);
+            /* SREM key r1 r2 ..., SADD key a1 a2 ..., SCARD key */
+            if (!(adds && apply_delta(rc, key, key_len, "SREM", dels, "SADD", adds,
+                                      gsu_ext->opts.batch_size, "SCARD", arrlen(val))) && !rc->err)
+            {
+                /* MULTI, DEL, SADD key m1 m2 ..., EXEC */
+                replace_members(rc, "SADD", key, key_len, val, gsu_ext->opts.batch_size,
+                            &gsu_ext->opts);
+            }
+        } else {
+            reply = redisCommand(rc, "DEL %b", key, (size_t) key_len);
+            if (reply) {
+                freeReplyObject(reply);
+                reply = NULL;
             }
         }
     }
@@ -1767,7 +1957,7 @@ retry:
             return;
         }
         retry = 1;
-        if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+        if(conn_reconnect(gsu_ext->conn))
             goto retry;
     }
 
@@ -1800,11 +1990,8 @@ redis_arrset_untie(Param pm)
 {
     struct gsu_array_ext *gsu_ext = (struct gsu_array_ext *) pm->gsu.a;
 
-    if (gsu_ext->rc) { /* <- paranoia ... actually not! used by the new no-connect lazy mode */
-        redisFree(gsu_ext->rc);
-        gsu_ext->rc = NULL;
-        fdtable[gsu_ext->fdesc] = FDT_UNUSED;
-    }
+    /* Release the shared connection */
+    conn_detach(&gsu_ext->conn);
 
     /* Remove from list of tied parameters */
     zsh_db_filter_arr(&zredis_tied, pm->node.nam);
@@ -1814,8 +2001,7 @@ redis_arrset_untie(Param pm)
 
     /* Free gsu_ext */
     zsfree(gsu_ext->redis_host_port);
-    if (gsu_ext->password)
-        zsfree(gsu_ext->password);
+    conn_release(gsu_ext->conn);
     zsfree(gsu_ext->key);
     zfree(gsu_ext, sizeof(struct gsu_array_ext));
 }
@@ -1831,9 +2017,11 @@ redis_arrset_untie(Param pm)
  * it might be not PM_UPTODATE - which means that database
  * wasn't yet queried.
  *
- * It will be left in this state if database doesn't
- * contain such key. That might be a drawback, maybe
- * setting to empty value has sense.
+ * If database doesn't contain such key, the param is
+ * marked as missing (PM_UPTODATE with NULL u.str, see
+ * cache_missing()), so that next reads don't query the
+ * server. The mark is cleared by local write, ztclear,
+ * -o ttl / -o track, or when -o negcache= is reached.
  */
 
 /**/
@@ -1850,6 +2038,8 @@ redis_zset_getfn(Param pm)
     gsu_ext = (struct gsu_scalar_ext *) pm->gsu.s;
 
     /* Key already retrieved? */
+    conn_poll_invalidations(gsu_ext->conn);
+    cache_expire(pm, gsu_ext->ht, gsu_ext->opts.ttl_ms, &gsu_ext->cache_expires);
     if ((pm->node.flags & PM_UPTODATE) && gsu_ext->use_cache) {
         return pm->u.str ? pm->u.str : "";
     }
@@ -1867,7 +2057,7 @@ redis_zset_getfn(Param pm)
 
     retry = 0;
  retry:
-    rc = gsu_ext->rc;
+    rc = conn_rc(gsu_ext->conn);
 
     if(rc) {
         reply = redisCommand(rc, "ZSCORE %b %b", main_key, (size_t) main_key_len, key, (size_t) key_len);
@@ -1893,13 +2083,16 @@ redis_zset_getfn(Param pm)
             /* Can return pointer, correctly saved inside hash */
             return pm->u.str;
         } else if (reply) {
+            /* Database doesn't have the element */
+            if (reply->type == REDIS_REPLY_NIL)
+                cache_missing(pm, gsu_ext);
             freeReplyObject(reply);
         }
     }
 
     if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
         retry = 1;
-        if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+        if(conn_reconnect(gsu_ext->conn))
             goto retry;
     } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
         zwarn("Aborting (no connection)");
@@ -1909,6 +2102,10 @@ redis_zset_getfn(Param pm)
     zsh_db_set_length(umkey, key_len);
     zsfree(umkey);
 
+    /* No connection (e.g. reconnect backoff) – last known value */
+    if (!gsu_ext->conn->rc && pm->u.str)
+        return pm->u.str;
+
     return "";
 }
 /* }}} */
@@ -1925,26 +2122,29 @@ redis_zset_setfn(Param pm, char *val)
     redisReply *reply = NULL;
     int retry;
 
+    gsu_ext = (struct gsu_scalar_ext *) pm->gsu.s;
+
     /* Set is done on parameter and on database. */
 
-    /* Parameter */
+    /* Parameter – also drops the negative
+     * cache mark (PM_UPTODATE, NULL u.str) */
     if (pm->u.str) {
         zsfree(pm->u.str);
         pm->u.str = NULL;
-        pm->node.flags &= ~(PM_UPTODATE);
     }
+    pm->node.flags &= ~(PM_UPTODATE);
 
     if (val) {
         pm->u.str = ztrdup(val);
-        pm->node.flags |= PM_UPTODATE;
+        /* With -o track only what's read is tracked by the server */
+        if (!gsu_ext->opts.track)
+            pm->node.flags |= PM_UPTODATE;
     }
 
     /* Database */
-    gsu_ext = (struct gsu_scalar_ext *) pm->gsu.s;
-
     retry = 0;
  retry:
-    rc = gsu_ext->rc;
+    rc = conn_rc(gsu_ext->conn);
 
     /* Can be NULL, when calling unset after untie */
     if (no_database_action == 0) {
@@ -1989,7 +2189,7 @@ redis_zset_setfn(Param pm, char *val)
 
         if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
             retry = 1;
-            if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+            if(conn_reconnect(gsu_ext->conn))
                 goto retry;
         } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
             zwarn("Aborting (no connection)");
@@ -2026,8 +2226,8 @@ redis_zset_get_node(HashTable ht, const char *name)
      *
      * Add the Param to its hash, it is not PM_UPTODATE.
      * It will be loaded from database *and filled*
-     * or left in that state if the database doesn't
-     * contain it.
+     * or marked as missing (negative cache) if the
+     * database doesn't contain it.
      */
 
     if (!val_pm) {
@@ -2035,7 +2235,11 @@ redis_zset_get_node(HashTable ht, const char *name)
         val_pm->node.flags = PM_SCALAR | PM_HASHELEM; /* no PM_UPTODATE */
         val_pm->gsu.s = (GsuScalar) ht->tmpdata;
         ht->addnode(ht, ztrdup(name), val_pm); // sets pm->node.nam
+
+        /* Keep within -o cache= limit */
+        cache_evict(ht, (struct gsu_scalar_ext *) ht->tmpdata, (HashNode) val_pm);
     }
+    val_pm->node.flags |= PM_RECENT;
 
     return (HashNode) val_pm;
 }
@@ -2046,86 +2250,11 @@ redis_zset_get_node(HashTable ht, const char *name)
 static void
 zset_scan_keys(HashTable ht, ScanFunc func, int flags)
 {
-    char *main_key, *key;
-    size_t main_key_len, key_len, j;
-    unsigned long long cursor = 0;
-    redisContext *rc;
-    redisReply *reply = NULL, *reply2 = NULL;
-    struct gsu_scalar_ext *gsu_ext;
+    struct gsu_scalar_ext *gsu_ext = (struct gsu_scalar_ext *) ht->tmpdata;
 
-    gsu_ext = (struct gsu_scalar_ext *) ht->tmpdata;
-    main_key = gsu_ext->key;
-    main_key_len = gsu_ext->key_len;
-
-    /* Iterate keys adding them to hash, so we have Param to use in `func` */
-    do {
-        int retry = 0;
-    retry:
-        rc = gsu_ext->rc;
-
-        if (rc)
-            reply = redisCommand(rc, "ZSCAN %b %llu", main_key, (size_t) main_key_len, cursor);
-
-        /* Disconnect detection */
-        if (!rc || rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)) {
-            if (reply)
-                freeReplyObject(reply);
-            if (retry) {
-                zwarn("Aborting (not connected)");
-                break;
-            }
-            retry = 1;
-            if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
-                goto retry;
-            else
-                break;
-        }
-
-        if (reply == NULL || reply->type != REDIS_REPLY_ARRAY || reply->elements != 2) {
-            if (reply && reply->type == REDIS_REPLY_ERROR) {
-                zwarn("Aborting, problem occured during ZSCAN: %s", reply->str);
-            } else {
-                zwarn("Problem occured during ZSCAN, no error message available, aborting");
-            }
-            if (reply)
-                freeReplyObject(reply);
-            break;
-        }
-
-        /* Get new cursor */
-        if (reply->element[0]->type == REDIS_REPLY_STRING) {
-            cursor = strtoull(reply->element[0]->str, NULL, 10);
-        } else {
-            zwarn("Error 2 occured during ZSCAN");
-            break;
-        }
-
-        reply2 = reply->element[1];
-        if (reply2 == NULL || reply2->type != REDIS_REPLY_ARRAY) {
-            zwarn("Error 3 occured during ZSCAN");
-            break;
-        }
-
-        for (j = 0; j < reply2->elements; j+= 2) {
-            redisReply *entry = reply2->element[j];
-            if (entry == NULL || entry->type != REDIS_REPLY_STRING) {
-                continue;
-            }
-
-            key = entry->str;
-            key_len = entry->len;
-
-            /* This returns database-interfacing Param,
-            * it will return u.str or first fetch data
-            * if not PM_UPTODATE (newly created) */
-            char *zkey = metafy(key, key_len, META_DUP);
-            HashNode hn = redis_zset_get_node(ht, zkey);
-            zsfree(zkey);
-
-            func(hn, flags);
-        }
-        freeReplyObject(reply);
-    } while (cursor != 0);
+    gsu_ext->scanning ++;
+    scan_pairs(ht, "ZCARD", "ZRANGE %b 0 -1 WITHSCORES", "ZSCAN", redis_zset_get_node, func, flags);
+    gsu_ext->scanning --;
 }
 /* }}} */
 /* FUNCTION: redis_hash_zset_setfn {{{ */
@@ -2138,9 +2267,8 @@ zset_scan_keys(HashTable ht, ScanFunc func, int flags)
 static void
 redis_hash_zset_setfn(Param pm, HashTable ht)
 {
-    HashNode hn;
-    char *main_key, *key, *content;
-    size_t main_key_len, key_len, content_len, i;
+    char *main_key;
+    size_t main_key_len;
     redisContext *rc;
     redisReply *reply = NULL;
     struct gsu_scalar_ext *gsu_ext;
@@ -2150,13 +2278,42 @@ redis_hash_zset_setfn(Param pm, HashTable ht)
         return;
 
     gsu_ext = (struct gsu_scalar_ext *) pm->u.hash->tmpdata;
+    main_key = gsu_ext->key;
+    main_key_len = gsu_ext->key_len;
+
+    if (ht) {
+        /* MULTI, DEL, ZADD key s1 m1 s2 m2 ..., EXEC */
+        char **args = hash_to_args(ht, 1);
+
+        retry = 0;
+     retry2:
+        rc = conn_rc(gsu_ext->conn);
+
+        if (rc)
+            replace_members(rc, "ZADD", main_key, main_key_len, args, 2 * gsu_ext->opts.batch_size,
+                            &gsu_ext->opts);
+
+        /* Disconnect detection */
+        if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
+            retry = 1;
+            if(conn_reconnect(gsu_ext->conn))
+                goto retry2;
+        } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
+            zwarn("Aborting (no connection)");
+        }
+
+        no_database_action = 1;
+        emptyhashtable(pm->u.hash);
+        no_database_action = 0;
+
+        /* We reuse our hash, the input is to be deleted */
+        deleteparamtable(ht);
+        return;
+    }
 
     retry = 0;
  retry:
-    rc = gsu_ext->rc;
-
-    main_key = gsu_ext->key;
-    main_key_len = gsu_ext->key_len;
+    rc = conn_rc(gsu_ext->conn);
 
     /* PRUNE */
     if (rc) {
@@ -2173,7 +2330,7 @@ redis_hash_zset_setfn(Param pm, HashTable ht)
  do_retry:
     if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
         retry = 1;
-        if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+        if(conn_reconnect(gsu_ext->conn))
             goto retry;
         else
             return;
@@ -2185,112 +2342,41 @@ redis_hash_zset_setfn(Param pm, HashTable ht)
     no_database_action = 1;
     emptyhashtable(pm->u.hash);
     no_database_action = 0;
+}
+/* }}} */
+/* FUNCTION: redis_hash_zset_unsetfn {{{ */
 
-    if (!ht)
-        return;
+/**/
+static void
+redis_hash_zset_unsetfn(Param pm, UNUSED(int exp))
+{
+    /* Remember custom GSU structure assigned to
+     * u.hash->tmpdata before hash gets deleted */
+    struct gsu_scalar_ext * gsu_ext = pm->u.hash->tmpdata;
 
-     /* Put new strings into database, having
-      * their interfacing-Params created */
+    if (!gsu_ext->unset_deletes || doing_untie) {
+        /* This will make database contents survive the
+        * unset, as standard GSU will be put in place */
+        redis_hash_zset_untie(pm);
+        no_database_action = 1;
+    }
 
-    retry = 0;
- retry2:
-    rc = gsu_ext->rc;
+    /* Uses normal unsetter (because gdbmuntie is called above).
+     * Will delete all owned field-parameters and also hashtable. */
+    pm->gsu.h->setfn(pm, NULL);
 
-    if (rc) {
-        for (i = 0; i < ht->hsize; i++) {
-            for (hn = ht->nodes[i]; hn; hn = hn->next) {
-                struct value v;
-                int umlen;
-                char *umkey, *umval;
+    if (gsu_ext->unset_deletes && !doing_untie) {
+        redis_hash_zset_untie(pm);
+    } else {
+        no_database_action = 0;
+    }
 
-                v.isarr = v.flags = v.start = 0;
-                v.end = -1;
-                v.arr = NULL;
-                v.pm = (Param) hn;
-
-                /* Unmetafy key */
-                umlen = 0;
-                umkey = zsh_db_unmetafy_zalloc(v.pm->node.nam, &umlen);
-
-                key = umkey;
-                key_len = umlen;
-
-                queue_signals();
-
-                /* Unmetafy data */
-                umval = zsh_db_unmetafy_zalloc(getstrvalue(&v), &umlen);
-
-                content = umval;
-                content_len = umlen;
-
-                /* ZADD myzset 1.0 element1 */
-                reply = redisCommand(rc, "ZADD %b %b %b", main_key, (size_t) main_key_len,
-                                    content, (size_t) content_len,
-                                    key, (size_t) key_len);
-                if (reply) {
-                    freeReplyObject(reply);
-                    reply = NULL;
-                }
-                if (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF))
-                    break;
-
-                /* Free, restoring original length */
-                zsh_db_set_length(umval, content_len);
-                zsfree(umval);
-                zsh_db_set_length(umkey, key_len);
-                zsfree(umkey);
-
-                unqueue_signals();
-            }
-        }
-
-        /* Disconnect detection */
-        if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
-            retry = 1;
-            if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
-                goto retry2;
-        } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
-            zwarn("Aborting (no connection)");
-        }
-    }
-    /* We reuse our hash, the input is to be deleted */
-    deleteparamtable(ht);
-}
-/* }}} */
-/* FUNCTION: redis_hash_zset_unsetfn {{{ */
-
-/**/
-static void
-redis_hash_zset_unsetfn(Param pm, UNUSED(int exp))
-{
-    /* Remember custom GSU structure assigned to
-     * u.hash->tmpdata before hash gets deleted */
-    struct gsu_scalar_ext * gsu_ext = pm->u.hash->tmpdata;
-
-    if (!gsu_ext->unset_deletes || doing_untie) {
-        /* This will make database contents survive the
-        * unset, as standard GSU will be put in place */
-        redis_hash_zset_untie(pm);
-        no_database_action = 1;
-    }
-
-    /* Uses normal unsetter (because gdbmuntie is called above).
-     * Will delete all owned field-parameters and also hashtable. */
-    pm->gsu.h->setfn(pm, NULL);
-
-    if (gsu_ext->unset_deletes && !doing_untie) {
-        redis_hash_zset_untie(pm);
-    } else {
-        no_database_action = 0;
-    }
-
-    /* Don't need custom GSU structure with its
-     * redisContext pointer anymore */
-    zsfree(gsu_ext->redis_host_port);
-    if (gsu_ext->password)
-        zsfree(gsu_ext->password);
-    zsfree(gsu_ext->key);
-    zfree(gsu_ext, sizeof(struct gsu_scalar_ext));
+    /* Don't need custom GSU structure with its
+     * redisContext pointer anymore */
+    zsfree(gsu_ext->redis_host_port);
+    conn_release(gsu_ext->conn);
+    zsfree(gsu_ext->key);
+    zfree(gsu_ext, sizeof(struct gsu_scalar_ext));
 
     pm->node.flags |= PM_UNSET;
 }
@@ -2302,16 +2388,11 @@ static void
 redis_hash_zset_untie(Param pm)
 {
     struct gsu_scalar_ext *gsu_ext = (struct gsu_scalar_ext *)pm->u.hash->tmpdata;
-    redisContext *rc = gsu_ext->rc;
     HashTable ht = pm->u.hash;
 
-    if (rc) { /* <- paranoia ... actually not! used by the new no-connect lazy mode */
-        redisFree(rc);
-        fdtable[gsu_ext->fdesc] = FDT_UNUSED;
-
-        /* Let hash fields know there's no backend */
-        ((struct gsu_scalar_ext *)ht->tmpdata)->rc = NULL;
-    }
+    /* Release the shared connection, hash fields
+     * will know there's no backend (rc is NULL) */
+    conn_detach(&gsu_ext->conn);
 
     /* Remove from list of tied parameters */
     zsh_db_filter_arr(&zredis_tied, pm->node.nam);
@@ -2369,7 +2450,7 @@ bin_zrzset(char *nam, char **args, Options ops, UNUSED(int func))
         struct gsu_scalar_ext *gsu_ext;
 
         gsu_ext = (struct gsu_scalar_ext *) pm->u.hash->tmpdata;
-        rc = gsu_ext->rc;
+        rc = conn_rc(gsu_ext->conn);
         main_key = gsu_ext->key;
         main_key_len = gsu_ext->key_len;
 
@@ -2510,8 +2591,11 @@ bin_zrpush(char *nam, char **args, Options ops, UNUSED(int func))
         key = gsu_ext->key;
         key_len = gsu_ext->key_len;
 
+        /* Indices of the zrlrange window will change */
+        list_window_drop(gsu_ext);
+
 retry:
-	rc = gsu_ext->rc;
+	rc = conn_rc(gsu_ext->conn);
 
 	if (rc) {
             /* Skip trailing ']' */
@@ -2605,7 +2689,7 @@ retry:
 		    return 1;
 		}
 		retry = 1;
-		if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+		if(conn_reconnect(gsu_ext->conn))
 		    goto retry;
 		else
 		    return 1;
@@ -2629,7 +2713,7 @@ retry:
                 return 1;
             }
             retry = 1;
-            if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+            if(conn_reconnect(gsu_ext->conn))
                 goto retry;
         }
     } else {
@@ -2639,6 +2723,217 @@ retry:
     return 0;
 }
 /* }}} */
+/* FUNCTION: bin_zrlrange {{{ */
+
+/*
+ * Subscript of a tied list without fetching whole list:
+ * zsh's array GSU has no access to the subscript, so that
+ * $list[i] always reads all elements. Indices are as in
+ * zsh subscripts (1-based, negative count from the end).
+ * Cached list is sliced locally, otherwise the window is
+ * fetched with LRANGE (together with LLEN, in MULTI/EXEC)
+ * and kept, so that reads within it don't query the server.
+ * The window is dropped like the cached list – on write,
+ * ztclear, -o ttl sweep and -o track invalidation.
+ */
+
+/**/
+static int
+bin_zrlrange(char *nam, char **args, Options ops, UNUSED(int func))
+{
+    Param pm;
+    struct gsu_array_ext *gsu_ext;
+    redisContext *rc;
+    redisReply *reply = NULL, *replies[4];
+    char **arr, *eptr;
+    long idx[2], llen;
+    int retry, i, j;
+
+    if (OPT_ISSET(ops,'h')) {
+        zrlrange_usage();
+        return 0;
+    }
+
+    if (!args[0] || !args[1]) {
+        zwarnnam(nam, "list parameter name and index are required, see -h");
+        return 1;
+    }
+
+    pm = (Param) paramtab->getnode(paramtab, args[0]);
+    if (!pm) {
+        zwarnnam(nam, "no such parameter: %s", args[0]);
+        return 1;
+    }
+
+    if (pm->gsu.a->getfn != &redis_arrlist_getfn) {
+        zwarnnam(nam, "not a tied list parameter: `%s', $reply array unchanged", args[0]);
+        return 1;
+    }
+
+    /* Zsh subscript -> Redis index: 1 is 0, -1 stays -1 */
+    for (i = 0; i < (args[2] ? 2 : 1); i++) {
+        idx[i] = zstrtol(args[i+1], &eptr, 10);
+        if (*eptr || idx[i] == 0) {
+            zwarnnam(nam, "invalid index: `%s' (non-zero number expected)", args[i+1]);
+            return 1;
+        }
+        if (idx[i] > 0)
+            idx[i] --;
+    }
+    if (!args[2])
+        idx[1] = idx[0];
+
+    gsu_ext = (struct gsu_array_ext *) pm->gsu.a;
+
+    /* Whole list or the window cached? */
+    conn_poll_invalidations(gsu_ext->conn);
+    cache_expire(pm, NULL, gsu_ext->opts.ttl_ms, &gsu_ext->cache_expires);
+    if (gsu_ext->use_cache) {
+        arr = NULL;
+        if (pm->node.flags & PM_UPTODATE) {
+            arr = list_window(pm->u.arr ? pm->u.arr : &my_nullarray, 0,
+                              pm->u.arr ? arrlen(pm->u.arr) : 0, idx[0], idx[1]);
+        } else if (gsu_ext->win && gsu_ext->win_sweep == gsu_ext->cache_expires) {
+            arr = list_window(gsu_ext->win, gsu_ext->win_start, gsu_ext->win_llen, idx[0], idx[1]);
+        }
+        if (arr) {
+            assignaparam("reply", arr, 0);
+            return 0;
+        }
+    }
+
+    retry = 0;
+ retry:
+    rc = conn_rc(gsu_ext->conn);
+
+    if (rc) {
+        /* Length is needed to place the window, in the same
+         * transaction so that it matches the elements */
+        queue_signals();
+        redisAppendCommand(rc, "MULTI");
+        redisAppendCommand(rc, "LLEN %b", gsu_ext->key, (size_t) gsu_ext->key_len);
+        redisAppendCommand(rc, "LRANGE %b %ld %ld", gsu_ext->key, (size_t) gsu_ext->key_len,
+                           idx[0], idx[1]);
+        redisAppendCommand(rc, "EXEC");
+        unqueue_signals();
+
+        for (i = 0; i < 4; i++) {
+            replies[i] = NULL;
+            if (REDIS_OK != redisGetReply(rc, (void **) &replies[i])) {
+                for (; i >= 0; i--) {
+                    if (replies[i])
+                        freeReplyObject(replies[i]);
+                }
+                goto failed;
+            }
+        }
+        for (i = 0; i < 3; i++)
+            freeReplyObject(replies[i]);
+        reply = replies[3];
+
+        if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 2 &&
+            reply->element[0]->type == REDIS_REPLY_INTEGER &&
+            reply->element[1]->type == REDIS_REPLY_ARRAY)
+        {
+            redisReply *elems = reply->element[1];
+
+            llen = (long) reply->element[0]->integer;
+            arr = (char **) zshcalloc((elems->elements + 1) * sizeof(char *));
+            for (i = 0, j = 0; i < elems->elements; i++) {
+                if (elems->element[i]->type == REDIS_REPLY_STRING)
+                    arr[j++] = metafy(elems->element[i]->str, elems->element[i]->len, META_DUP);
+            }
+            freeReplyObject(reply);
+
+            /* Keep the window */
+            list_window_drop(gsu_ext);
+            if (gsu_ext->use_cache) {
+                for (i = 0; i < 2; i++) {
+                    if (idx[i] < 0)
+                        idx[i] += llen;
+                }
+                gsu_ext->win = zarrdup(arr);
+                gsu_ext->win_start = idx[0] < 0 ? 0 : idx[0];
+                gsu_ext->win_llen = llen;
+                gsu_ext->win_sweep = gsu_ext->cache_expires;
+            }
+
+            assignaparam("reply", arr, 0);
+            return 0;
+        }
+
+        if (reply->type == REDIS_REPLY_ERROR)
+            zwarnnam(nam, "error when fetching elements of `%s' (%s)", args[0], reply->str);
+        else if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 2 &&
+                 reply->element[0]->type == REDIS_REPLY_ERROR)
+            zwarnnam(nam, "error when fetching elements of `%s' (%s)", args[0], reply->element[0]->str);
+        freeReplyObject(reply);
+        return 1;
+    }
+
+ failed:
+    if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
+        retry = 1;
+        if(conn_reconnect(gsu_ext->conn))
+            goto retry;
+    } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
+        zwarn("Aborting (no connection)");
+    }
+
+    return 1;
+}
+/* }}} */
+/* FUNCTION: list_window {{{ */
+
+/*
+ * Elements `start' .. `end' (Redis indices, negative count
+ * from the end) of a list of `llen' elements, taken from
+ * `elems', which hold the list's elements from index `first'.
+ * Returns NULL if they aren't all there, otherwise a new
+ * array, empty if the range is outside of the list
+ */
+
+/**/
+static char **
+list_window(char **elems, long first, long llen, long start, long end)
+{
+    char **arr;
+    long count, j;
+
+    if (start < 0)
+        start += llen;
+    if (end < 0)
+        end += llen;
+    if (start < 0)
+        start = 0;
+    if (end >= llen)
+        end = llen - 1;
+
+    count = end >= start ? end - start + 1 : 0;
+    if (count && (start < first || end >= first + arrlen(elems)))
+        return NULL;
+
+    arr = (char **) zshcalloc((count + 1) * sizeof(char *));
+    for (j = 0; j < count; j++)
+        arr[j] = ztrdup(elems[start - first + j]);
+    arr[count] = NULL;
+
+    return arr;
+}
+/* }}} */
+/* FUNCTION: list_window_drop {{{ */
+
+/* Frees the window of list cached by zrlrange */
+
+static void
+list_window_drop(struct gsu_array_ext *gsu_ext)
+{
+    if (gsu_ext->win) {
+        freearray(gsu_ext->win);
+        gsu_ext->win = NULL;
+    }
+}
+/* }}} */
 
 /************ HSET HASH ELEM *************/
 
@@ -2650,9 +2945,11 @@ retry:
  * it might be not PM_UPTODATE - which means that database
  * wasn't yet queried.
  *
- * It will be left in this state if database doesn't
- * contain such key. That might be a drawback, maybe
- * setting to empty value has sense.
+ * If database doesn't contain such key, the param is
+ * marked as missing (PM_UPTODATE with NULL u.str, see
+ * cache_missing()), so that next reads don't query the
+ * server. The mark is cleared by local write, ztclear,
+ * -o ttl / -o track, or when -o negcache= is reached.
  */
 
 /**/
@@ -2669,6 +2966,8 @@ redis_hset_getfn(Param pm)
     gsu_ext = (struct gsu_scalar_ext *) pm->gsu.s;
 
     /* Key already retrieved? */
+    conn_poll_invalidations(gsu_ext->conn);
+    cache_expire(pm, gsu_ext->ht, gsu_ext->opts.ttl_ms, &gsu_ext->cache_expires);
     if ((pm->node.flags & PM_UPTODATE) && gsu_ext->use_cache) {
         return pm->u.str ? pm->u.str : "";
     }
@@ -2686,7 +2985,7 @@ redis_hset_getfn(Param pm)
 
     retry = 0;
  retry:
-    rc = gsu_ext->rc;
+    rc = conn_rc(gsu_ext->conn);
 
     if (rc) {
         reply = redisCommand(rc, "HGET %b %b", main_key, (size_t) main_key_len, key, (size_t) key_len);
@@ -2712,13 +3011,16 @@ redis_hset_getfn(Param pm)
             /* Can return pointer, correctly saved inside hash */
             return pm->u.str;
         } else if (reply) {
+            /* Database doesn't have the element */
+            if (reply->type == REDIS_REPLY_NIL)
+                cache_missing(pm, gsu_ext);
             freeReplyObject(reply);
         }
     }
 
     if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
         retry = 1;
-        if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+        if(conn_reconnect(gsu_ext->conn))
             goto retry;
     } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
         zwarn("Aborting (no connection)");
@@ -2728,6 +3030,10 @@ redis_hset_getfn(Param pm)
     zsh_db_set_length(umkey, key_len);
     zsfree(umkey);
 
+    /* No connection (e.g. reconnect backoff) – last known value */
+    if (!gsu_ext->conn->rc && pm->u.str)
+        return pm->u.str;
+
     return "";
 }
 /* }}} */
@@ -2744,26 +3050,29 @@ redis_hset_setfn(Param pm, char *val)
     redisReply *reply = NULL;
     int retry;
 
+    gsu_ext = (struct gsu_scalar_ext *) pm->gsu.s;
+
     /* Set is done on parameter and on database. */
 
-    /* Parameter */
+    /* Parameter – also drops the negative
+     * cache mark (PM_UPTODATE, NULL u.str) */
     if (pm->u.str) {
         zsfree(pm->u.str);
         pm->u.str = NULL;
-        pm->node.flags &= ~(PM_UPTODATE);
     }
+    pm->node.flags &= ~(PM_UPTODATE);
 
     if (val) {
         pm->u.str = ztrdup(val);
-        pm->node.flags |= PM_UPTODATE;
+        /* With -o track only what's read is tracked by the server */
+        if (!gsu_ext->opts.track)
+            pm->node.flags |= PM_UPTODATE;
     }
 
     /* Database */
-    gsu_ext = (struct gsu_scalar_ext *) pm->gsu.s;
-
     retry = 0;
  retry:
-    rc = gsu_ext->rc;
+    rc = conn_rc(gsu_ext->conn);
 
     /* Can be NULL, when calling unset after untie */
     if (no_database_action == 0) {
@@ -2808,7 +3117,7 @@ redis_hset_setfn(Param pm, char *val)
 
         if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
             retry = 1;
-            if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+            if(conn_reconnect(gsu_ext->conn))
                 goto retry;
         } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
             zwarn("Aborting (no connection)");
@@ -2845,8 +3154,8 @@ redis_hset_get_node(HashTable ht, const char *name)
      *
      * Add the Param to its hash, it is not PM_UPTODATE.
      * It will be loaded from database *and filled*
-     * or left in that state if the database doesn't
-     * contain it.
+     * or marked as missing (negative cache) if the
+     * database doesn't contain it.
      */
 
     if (!val_pm) {
@@ -2854,7 +3163,11 @@ redis_hset_get_node(HashTable ht, const char *name)
         val_pm->node.flags = PM_SCALAR | PM_HASHELEM; /* no PM_UPTODATE */
         val_pm->gsu.s = (GsuScalar) ht->tmpdata;
         ht->addnode(ht, ztrdup(name), val_pm); // sets pm->node.nam
+
+        /* Keep within -o cache= limit */
+        cache_evict(ht, (struct gsu_scalar_ext *) ht->tmpdata, (HashNode) val_pm);
     }
+    val_pm->node.flags |= PM_RECENT;
 
     return (HashNode) val_pm;
 }
@@ -2865,87 +3178,11 @@ redis_hset_get_node(HashTable ht, const char *name)
 static void
 hset_scan_keys(HashTable ht, ScanFunc func, int flags)
 {
-    char *main_key, *key;
-    size_t main_key_len, key_len, j;
-    unsigned long long cursor = 0;
-    redisContext *rc;
-    redisReply *reply = NULL, *reply2 = NULL;
-    struct gsu_scalar_ext *gsu_ext;
-
-    gsu_ext = (struct gsu_scalar_ext *) ht->tmpdata;
-    main_key = gsu_ext->key;
-    main_key_len = gsu_ext->key_len;
-
-    /* Iterate keys adding them to hash, so we have Param to use in `func` */
-    do {
-        int retry = 0;
-    retry:
-        rc = gsu_ext->rc;
-
-        if (rc)
-            reply = redisCommand(rc, "HSCAN %b %llu", main_key, (size_t) main_key_len, cursor);
-
-        /* Disconnect detection */
-        if (!rc || rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)) {
-            if (reply)
-                freeReplyObject(reply);
-            if (retry) {
-                zwarn("Aborting (not connected)");
-                break;
-            }
-            retry = 1;
-            if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
-                // The same cursor
-                goto retry;
-            else
-                break;
-        }
-
-        if (reply == NULL || reply->type != REDIS_REPLY_ARRAY || reply->elements != 2) {
-            if (reply && reply->type == REDIS_REPLY_ERROR) {
-                zwarn("Aborting, problem occured during HSCAN: %s", reply->str);
-            } else {
-                zwarn("Problem occured during HSCAN, no error message available, aborting");
-            }
-            if (reply)
-                freeReplyObject(reply);
-            break;
-        }
-
-        /* Get new cursor */
-        if (reply->element[0]->type == REDIS_REPLY_STRING) {
-            cursor = strtoull(reply->element[0]->str, NULL, 10);
-        } else {
-            zwarn("Error 2 occured during HSCAN");
-            break;
-        }
-
-        reply2 = reply->element[1];
-        if (reply2 == NULL || reply2->type != REDIS_REPLY_ARRAY) {
-            zwarn("Error 3 occured during HSCAN");
-            break;
-        }
-
-        for (j = 0; j < reply2->elements; j+= 2) {
-            redisReply *entry = reply2->element[j];
-            if (entry == NULL || entry->type != REDIS_REPLY_STRING) {
-                continue;
-            }
-
-            key = entry->str;
-            key_len = entry->len;
-
-            /* This returns database-interfacing Param,
-             * it will return u.str or first fetch data
-             * if not PM_UPTODATE (newly created) */
-            char *zkey = metafy(key, key_len, META_DUP);
-            HashNode hn = redis_hset_get_node(ht, zkey);
-            zsfree(zkey);
+    struct gsu_scalar_ext *gsu_ext = (struct gsu_scalar_ext *) ht->tmpdata;
 
-            func(hn, flags);
-        }
-        freeReplyObject(reply);
-    } while (cursor != 0);
+    gsu_ext->scanning ++;
+    scan_pairs(ht, "HLEN", "HGETALL %b", "HSCAN", redis_hset_get_node, func, flags);
+    gsu_ext->scanning --;
 }
 /* }}} */
 /* FUNCTION: redis_hash_hset_setfn {{{ */
@@ -2958,9 +3195,8 @@ hset_scan_keys(HashTable ht, ScanFunc func, int flags)
 static void
 redis_hash_hset_setfn(Param pm, HashTable ht)
 {
-    HashNode hn;
-    char *main_key, *key, *content;
-    size_t main_key_len, key_len, content_len, i;
+    char *main_key;
+    size_t main_key_len;
     redisContext *rc;
     redisReply *reply = NULL;
     struct gsu_scalar_ext *gsu_ext;
@@ -2970,41 +3206,82 @@ redis_hash_hset_setfn(Param pm, HashTable ht)
         return;
 
     gsu_ext = (struct gsu_scalar_ext *) pm->u.hash->tmpdata;
-
-    retry = 0;
- retry:
-    rc = gsu_ext->rc;
     main_key = gsu_ext->key;
     main_key_len = gsu_ext->key_len;
 
-    /* PRUNE - deleting a hset doesn't have any
-     * difference from deleting all its keys */
-    if (rc) {
-        reply = redisCommand(rc, "DEL %b", main_key, (size_t) main_key_len);
-        if (reply == NULL || reply->type != REDIS_REPLY_INTEGER) {
-            if (reply) {
-                zwarn("Error 5 occured (redis communication, reply != 0), database and tied hash not updated");
-            } else {
-                zwarn("Error 5 occured (redis communication, reply == 0), database and tied hash not updated");
-            }
-            if (reply) {
-                freeReplyObject(reply);
-                reply = NULL;
-            }
-            goto do_retry;
+    if (ht) {
+        /* MULTI, DEL, HSET key f1 v1 f2 v2 ..., EXEC */
+        char **args = hash_to_args(ht, 0), **dels = NULL, **adds = NULL;
+
+        /* Diff mode – HDEL removed and HSET changed fields,
+         * invalidated and expired values count as changed */
+        if (gsu_ext->opts.diff && gsu_ext->use_cache) {
+            conn_poll_invalidations(gsu_ext->conn);
+            cache_expire(NULL, pm->u.hash, gsu_ext->opts.ttl_ms, &gsu_ext->cache_expires);
+            hash_delta(pm->u.hash, ht, &dels, &adds);
         }
-    }
 
- do_retry:
+        retry = 0;
+     retry2:
+        rc = conn_rc(gsu_ext->conn);
 
-    if (reply) {
+        if (rc && !(adds && apply_delta(rc, main_key, main_key_len, "HDEL", dels, "HSET", adds,
+                                        2 * gsu_ext->opts.batch_size, "HLEN", ht->ct)) && !rc->err)
+        {
+            replace_members(rc, "HSET", main_key, main_key_len, args, 2 * gsu_ext->opts.batch_size,
+                            &gsu_ext->opts);
+        }
+
+        /* Disconnect detection */
+        if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
+            retry = 1;
+            if(conn_reconnect(gsu_ext->conn))
+                goto retry2;
+        } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
+            zwarn("Aborting (no connection)");
+        }
+
+        no_database_action = 1;
+        emptyhashtable(pm->u.hash);
+        no_database_action = 0;
+
+        /* We reuse our hash, the input is to be deleted */
+        deleteparamtable(ht);
+        return;
+    }
+
+    retry = 0;
+ retry:
+    rc = conn_rc(gsu_ext->conn);
+
+    /* PRUNE - deleting a hset doesn't have any
+     * difference from deleting all its keys */
+    if (rc) {
+        reply = redisCommand(rc, "DEL %b", main_key, (size_t) main_key_len);
+        if (reply == NULL || reply->type != REDIS_REPLY_INTEGER) {
+            if (reply) {
+                zwarn("Error 5 occured (redis communication, reply != 0), database and tied hash not updated");
+            } else {
+                zwarn("Error 5 occured (redis communication, reply == 0), database and tied hash not updated");
+            }
+            if (reply) {
+                freeReplyObject(reply);
+                reply = NULL;
+            }
+            goto do_retry;
+        }
+    }
+
+ do_retry:
+
+    if (reply) {
         freeReplyObject(reply);
         reply = NULL;
     }
 
     if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
         retry = 1;
-        if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+        if(conn_reconnect(gsu_ext->conn))
             goto retry;
         else
             return;
@@ -3016,72 +3293,6 @@ redis_hash_hset_setfn(Param pm, HashTable ht)
     no_database_action = 1;
     emptyhashtable(pm->u.hash);
     no_database_action = 0;
-
-    if (!ht)
-        return;
-
-     /* Put new strings into database, having
-      * their interfacing-Params created */
-
-    retry = 0;
- retry2:
-    rc = gsu_ext->rc;
-
-    if (rc) {
-        for (i = 0; i < ht->hsize; i++) {
-            for (hn = ht->nodes[i]; hn; hn = hn->next) {
-                struct value v;
-                int umlen;
-                char *umkey, *umval;
-
-                v.isarr = v.flags = v.start = 0;
-                v.end = -1;
-                v.arr = NULL;
-                v.pm = (Param) hn;
-
-                /* Unmetafy key */
-                umlen = 0;
-                umkey = zsh_db_unmetafy_zalloc(v.pm->node.nam, &umlen);
-
-                key = umkey;
-                key_len = umlen;
-
-                queue_signals();
-
-                /* Unmetafy data */
-                umval = zsh_db_unmetafy_zalloc(getstrvalue(&v), &umlen);
-
-                content = umval;
-                content_len = umlen;
-
-                /* HSET myhset element1 value */
-                reply = redisCommand(rc, "HSET %b %b %b", main_key, (size_t) main_key_len,
-                                    key, (size_t) key_len,
-                                    content, (size_t) content_len);
-                if (reply)
-                    freeReplyObject(reply);
-
-                /* Free, restoring original length */
-                zsh_db_set_length(umval, content_len);
-                zsfree(umval);
-                zsh_db_set_length(umkey, key_len);
-                zsfree(umkey);
-
-                unqueue_signals();
-            }
-        }
-
-        /* Disconnect detection */
-        if (!retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
-            retry = 1;
-            if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
-                goto retry2;
-        } else if (retry && (!rc || (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
-            zwarn("Aborting (no connection)");
-        }
-    }
-    /* We reuse our hash, the input is to be deleted */
-    deleteparamtable(ht);
 }
 /* }}} */
 /* FUNCTION: redis_hash_hset_unsetfn {{{ */
@@ -3114,8 +3325,7 @@ redis_hash_hset_unsetfn(Param pm, UNUSED(int exp))
     /* Don't need custom GSU structure with its
      * redisContext pointer anymore */
     zsfree(gsu_ext->redis_host_port);
-    if (gsu_ext->password)
-        zsfree(gsu_ext->password);
+    conn_release(gsu_ext->conn);
     zsfree(gsu_ext->key);
     zfree(gsu_ext, sizeof(struct gsu_scalar_ext));
 
@@ -3129,16 +3339,11 @@ static void
 redis_hash_hset_untie(Param pm)
 {
     struct gsu_scalar_ext *gsu_ext = (struct gsu_scalar_ext *)pm->u.hash->tmpdata;
-    redisContext *rc = gsu_ext->rc;
     HashTable ht = pm->u.hash;
 
-    if (rc) { /* <- paranoia ... actually not! used by the new no-connect lazy mode */
-        redisFree(rc);
-        fdtable[gsu_ext->fdesc] = FDT_UNUSED;
-
-        /* Let hash fields know there's no backend */
-        ((struct gsu_scalar_ext *)ht->tmpdata)->rc = NULL;
-    }
+    /* Release the shared connection, hash fields
+     * will know there's no backend (rc is NULL) */
+    conn_detach(&gsu_ext->conn);
 
     /* Remove from list of tied parameters */
     zsh_db_filter_arr(&zredis_tied, pm->node.nam);
@@ -3156,101 +3361,74 @@ redis_hash_hset_untie(Param pm)
 
 /* FUNCTION: redis_arrlist_getfn {{{ */
 
+/*
+ * Fetches (and caches) whole list – the GSU doesn't get
+ * the subscript, so also $list[i] reads all elements.
+ * zrlrange is the way to read only a window of a big list.
+ */
+
 /**/
 char **
 redis_arrlist_getfn(Param pm)
 {
     struct gsu_array_ext *gsu_ext;
-    char *key;
-    size_t key_len;
-    redisContext *rc;
-    redisReply *reply = NULL;
-    int j, retry;
+    redisReply *reply;
+    int j;
 
     gsu_ext = (struct gsu_array_ext *) pm->gsu.a;
     /* Key already retrieved? */
+    conn_poll_invalidations(gsu_ext->conn);
+    cache_expire(pm, NULL, gsu_ext->opts.ttl_ms, &gsu_ext->cache_expires);
     if ((pm->node.flags & PM_UPTODATE) && gsu_ext->use_cache) {
         return pm->u.arr ? pm->u.arr : &my_nullarray;
     }
 
-    key = gsu_ext->key;
-    key_len = gsu_ext->key_len;
-
-    retry = 0;
- retry:
-    rc = gsu_ext->rc;
+    reply = fetch_key(gsu_ext->conn, "LRANGE %b 0 -1", gsu_ext->key, gsu_ext->key_len);
 
-    if (rc) {
-        reply = redisCommand(rc, "EXISTS %b", key, (size_t) key_len);
-        if (reply && reply->type == REDIS_REPLY_INTEGER && reply->integer == 1) {
-            freeReplyObject(reply);
-            reply = NULL;
+    if (reply) {
+        /* We have data – store it and return it */
+        pm->node.flags |= PM_UPTODATE;
 
-            reply = redisCommand(rc, "LRANGE %b 0 -1", key, (size_t) key_len);
-            if (reply && reply->type == REDIS_REPLY_ARRAY) {
-                /* We have data – store it and return it */
-                pm->node.flags |= PM_UPTODATE;
+        /* Ensure there's no leak */
+        if (pm->u.arr) {
+            freearray(pm->u.arr);
+            pm->u.arr = NULL;
+        }
 
-                /* Ensure there's no leak */
-                if (pm->u.arr) {
-                    freearray(pm->u.arr);
-                    pm->u.arr = NULL;
-                }
+        pm->u.arr = zalloc((reply->elements + 1) * sizeof(char*));
 
-                pm->u.arr = zalloc((reply->elements + 1) * sizeof(char*));
-
-                for (j = 0; j < reply->elements; j++) {
-                    if (NULL == reply->element[j]) {
-                        pm->u.arr[j] = ztrdup("");
-                        zwarn("Error 8 when fetching elements");
-                        continue;
-                    } else if (reply->element[j]->type != REDIS_REPLY_STRING) {
-                        pm->u.arr[j] = ztrdup("");
-                        if (NULL != reply->element[j]->str && reply->element[j]->len > 0) {
-                            zwarn("Error 9 when fetching elements (message: %s)", reply->element[j]->str);
-                        } else {
-                            zwarn("Error 9 when fetching elements");
-                        }
-                        continue;
-                    }
-                    /* Metafy returned data. All fits - metafy
-                    * can obtain data length to avoid using \0 */
-                    pm->u.arr[j] = metafy(reply->element[j]->str,
-                                        reply->element[j]->len,
-                                        META_DUP);
+        for (j = 0; j < reply->elements; j++) {
+            if (NULL == reply->element[j]) {
+                pm->u.arr[j] = ztrdup("");
+                zwarn("Error 8 when fetching elements");
+                continue;
+            } else if (reply->element[j]->type != REDIS_REPLY_STRING) {
+                pm->u.arr[j] = ztrdup("");
+                if (NULL != reply->element[j]->str && reply->element[j]->len > 0) {
+                    zwarn("Error 9 when fetching elements (message: %s)", reply->element[j]->str);
+                } else {
+                    zwarn("Error 9 when fetching elements");
                 }
-                pm->u.arr[reply->elements] = NULL;
-
-                freeReplyObject(reply);
-                reply = NULL;
-
-                /* Can return pointer, correctly saved inside Param */
-                return pm->u.arr;
-            } else if (reply) {
-                freeReplyObject(reply);
-                reply = NULL;
+                continue;
             }
-        } else if (reply) {
-            freeReplyObject(reply);
-            reply = NULL;
+            /* Metafy returned data. All fits - metafy
+            * can obtain data length to avoid using \0 */
+            pm->u.arr[j] = metafy(reply->element[j]->str,
+                                reply->element[j]->len,
+                                META_DUP);
         }
-    }
+        pm->u.arr[reply->elements] = NULL;
 
-    /* Disconnect detection */
-    if (!rc || rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)) {
-        if (reply) {
-            freeReplyObject(reply);
-            reply = NULL;
-        }
-        if (retry) {
-            zwarn("Aborting (no connection)");
-            return &my_nullarray;
-        }
-        retry = 1;
-        if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
-            goto retry;
+        freeReplyObject(reply);
+
+        /* Can return pointer, correctly saved inside Param */
+        return pm->u.arr;
     }
 
+    /* No connection (e.g. reconnect backoff) – last known value */
+    if (!gsu_ext->conn->rc && pm->u.arr)
+        return pm->u.arr;
+
     /* Array with 0 elements */
     return &my_nullarray;
 }
@@ -3261,16 +3439,32 @@ redis_arrlist_getfn(Param pm)
 void
 redis_arrlist_setfn(Param pm, char **val)
 {
-    char *key, *content;
-    size_t key_len, content_len;
-    int alen = 0, j;
+    char *key, **adds = NULL;
+    const char *push_cmd = NULL;
+    size_t key_len;
     redisContext *rc;
     redisReply *reply = NULL;
     struct gsu_array_ext *gsu_ext;
 
+    gsu_ext = (struct gsu_array_ext *) pm->gsu.a;
+
+    /* Diff mode – is it cached list plus a suffix or prefix
+     * (lst+=( ... ))? Then only push the delta. Cache is
+     * first refreshed (invalidations, -o ttl=) */
+    if (val && pm->u.arr && pm->u.arr != val && gsu_ext->opts.diff && gsu_ext->use_cache) {
+        conn_poll_invalidations(gsu_ext->conn);
+        cache_expire(pm, NULL, gsu_ext->opts.ttl_ms, &gsu_ext->cache_expires);
+    }
+    if (val && pm->u.arr && pm->u.arr != val && gsu_ext->opts.diff &&
+        gsu_ext->use_cache && (pm->node.flags & PM_UPTODATE))
+    {
+        push_cmd = list_delta(pm->u.arr, val, &adds);
+    }
+
     /* Set is done on parameter and on database. */
 
     /* Parameter */
+    list_window_drop(gsu_ext);
     if (pm->u.arr && pm->u.arr != val) {
         freearray(pm->u.arr);
         pm->u.arr = NULL;
@@ -3278,13 +3472,13 @@ redis_arrlist_setfn(Param pm, char **val)
     }
 
     if (val) {
-        alen = arrlen(val);
         pm->u.arr = val;
-        pm->node.flags |= PM_UPTODATE;
+        /* With -o track only what's read is tracked by the server */
+        if (!gsu_ext->opts.track)
+            pm->node.flags |= PM_UPTODATE;
     }
 
     /* Database */
-    gsu_ext = (struct gsu_array_ext *) pm->gsu.a;
     key = gsu_ext->key;
     key_len = gsu_ext->key_len;
 
@@ -3293,48 +3487,22 @@ redis_arrlist_setfn(Param pm, char **val)
 
     int retry = 0;
 retry:
-    rc = gsu_ext->rc;
+    rc = conn_rc(gsu_ext->conn);
     if (rc) {
-        reply = redisCommand(rc, "DEL %b", key, (size_t) key_len);
-        if (reply) {
-            freeReplyObject(reply);
-            reply = NULL;
-        }
-
-        /* Disconnect detection */
-        if (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)) {
-            if (retry) {
-                zwarn("Aborting (no connection)");
-                return;
-            }
-            retry = 1;
-            if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
-                goto retry;
-            else
-                return;
-        }
-
         if (val) {
-            for (j=0; j<alen; j ++) {
-                /* Unmetafy with exact zalloc size */
-                int umlen = 0;
-                char *umval = zsh_db_unmetafy_zalloc(val[j], &umlen);
-
-                /* Store */
-                content = umval;
-                content_len = umlen;
-                reply = redisCommand(rc, "RPUSH %b %b", key, (size_t) key_len, content, (size_t) content_len);
-                if (reply) {
-                    freeReplyObject(reply);
-                    reply = NULL;
-                }
-                if (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)) {
-                    break;
-                }
-
-                /* Free */
-                zsh_db_set_length(umval, umlen);
-                zsfree(umval);
+            /* RPUSH or LPUSH key e1 e2 ..., LLEN key */
+            if (!(push_cmd && apply_delta(rc, key, key_len, NULL, NULL, push_cmd, adds,
+                                          gsu_ext->opts.batch_size, "LLEN", arrlen(val))) && !rc->err)
+            {
+                /* MULTI, DEL, RPUSH key e1 e2 ..., EXEC */
+                replace_members(rc, "RPUSH", key, key_len, val, gsu_ext->opts.batch_size,
+                            &gsu_ext->opts);
+            }
+        } else {
+            reply = redisCommand(rc, "DEL %b", key, (size_t) key_len);
+            if (reply) {
+                freeReplyObject(reply);
+                reply = NULL;
             }
         }
     }
@@ -3346,7 +3514,7 @@ retry:
             return;
         }
         retry = 1;
-        if(reconnect(&gsu_ext->rc, &gsu_ext->fdesc, gsu_ext->redis_host_port, gsu_ext->password))
+        if(conn_reconnect(gsu_ext->conn))
             goto retry;
     }
 
@@ -3379,11 +3547,8 @@ redis_arrlist_untie(Param pm)
 {
     struct gsu_array_ext *gsu_ext = (struct gsu_array_ext *) pm->gsu.a;
 
-    if (gsu_ext->rc) { /* <- paranoia ... actually not! used by the new no-connect lazy mode */
-        redisFree(gsu_ext->rc);
-        gsu_ext->rc = NULL;
-        fdtable[gsu_ext->fdesc] = FDT_UNUSED;
-    }
+    /* Release the shared connection */
+    conn_detach(&gsu_ext->conn);
 
     /* Remove from list of tied parameters */
     zsh_db_filter_arr(&zredis_tied, pm->node.nam);
@@ -3392,9 +3557,9 @@ redis_arrlist_untie(Param pm)
     pm->gsu.a = &stdarray_gsu;
 
     /* Free gsu_ext */
+    list_window_drop(gsu_ext);
     zsfree(gsu_ext->redis_host_port);
-    if (gsu_ext->password)
-        zsfree(gsu_ext->password);
+    conn_release(gsu_ext->conn);
     zsfree(gsu_ext->key);
     zfree(gsu_ext, sizeof(struct gsu_array_ext));
 }
@@ -3532,6 +3697,74 @@ deletehashparam(Param tied_param, const char *pmname) {
     paramtab->freenode(&tied_param->node);
 }
 /* }}} */
+/* FUNCTION: is_db_index {{{ */
+
+/* Is `len' bytes at `str' a database index (digits or empty)? */
+
+/**/
+static int
+is_db_index(const char *str, size_t len)
+{
+    for (; len; str++, len--) {
+        if (!idigit(*str))
+            return 0;
+    }
+    return 1;
+}
+/* }}} */
+/* FUNCTION: unix_path_end {{{ */
+
+/*
+ * Finds where socket path ends in unix:{path}/{db}/{key}
+ * address – at the first prefix that names an existing
+ * non-directory, or after a `.sock' component. If there's
+ * no such (socket not created yet), trailing {db}/{key} or
+ * {db} is split off like in TCP address, {db} being a number
+ * or empty, and `*guessed' is set. Returns pointer to the
+ * separating slash or NULL, when whole string is the path.
+ */
+
+/**/
+static char *
+unix_path_end(char *path, int *guessed)
+{
+    struct stat st;
+    char *slash, *last, *prev;
+
+    *guessed = 0;
+    for (slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        if (0 == stat(path, &st) && !S_ISDIR(st.st_mode)) {
+            *slash = '/';
+            return slash;
+        }
+        *slash = '/';
+    }
+
+    if ((slash = strstr(path, ".sock/")))
+        return slash + 5;
+
+    if (!(last = strrchr(path, '/')) || last == path)
+        return NULL;
+
+    /* {path}/{db}/{key} */
+    *last = '\0';
+    prev = strrchr(path, '/');
+    *last = '/';
+    if (prev && prev != path && is_db_index(prev + 1, last - prev - 1)) {
+        *guessed = 1;
+        return prev;
+    }
+
+    /* {path}/{db} */
+    if (is_db_index(last + 1, strlen(last + 1))) {
+        *guessed = 1;
+        return last;
+    }
+
+    return NULL;
+}
+/* }}} */
 /* FUNCTION: parse_host_string {{{ */
 
 static void
@@ -3543,7 +3776,20 @@ parse_host_string(const char *input, char *resource_name, int size, char **host,
     /* Parse -f argument */
     char *processed = resource_name;
     char *port_start, *key_start, *needle;
-    if ((port_start = strchr(processed, ':'))) {
+    int guessed;
+    if (0 == strncmp(processed, "unix:", 5)) {
+        /* Unix socket track: unix:/path/to/redis.sock/db/key */
+        *host = processed + 5;
+        *port = -1;
+        if ((needle = unix_path_end(processed + 5, &guessed))) {
+            *needle = '\0';
+            processed = needle + 1;
+            if (guessed)
+                zwarn("socket doesn't exist, assuming path `%s' and database/key `%s'", *host, processed);
+        } else {
+            processed = NULL;
+        }
+    } else if ((port_start = strchr(processed, ':'))) {
         if (port_start[1] != '\0') {
             if ((needle = strchr(port_start+1, '/'))) {
                 /* Port with following database index */
@@ -3601,16 +3847,22 @@ parse_host_string(const char *input, char *resource_name, int size, char **host,
 /* }}} */
 /* FUNCTION: connect {{{ */
 static int
-connect(redisContext **rc, const char* password, const char *host, int port, int db_index, const char *address)
+connect(redisContext **rc, const char* password, const char *host, int port, int db_index,
+        const char *address, int timeout_ms)
 {
     redisReply *reply = NULL;
 
-    /* Connect */
-    struct timeval timeout = { 1, 500000 }; // 1.5 seconds
-    *rc = redisConnectWithTimeout(host, port, timeout);
+    /* Connect, port -1 means unix socket */
+    struct timeval timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    if (port < 0)
+        *rc = redisConnectUnixWithTimeout(host, timeout);
+    else
+        *rc = redisConnectWithTimeout(host, port, timeout);
 
     if(*rc == NULL || (*rc)->err != 0) {
-        if(rc) {
+        if(*rc && port < 0) {
+            zwarn("error opening database unix:%s/%d (%s)", host, db_index, (*rc)->errstr);
+        } else if(*rc) {
             zwarn("error opening database %s:%d/%d (%s)", host, port, db_index, (*rc)->errstr);
             // redisFree(*rc);
             // *rc = NULL;
@@ -3620,18 +3872,36 @@ connect(redisContext **rc, const char* password, const char *host, int port, int
         return 0;
     }
 
+    /* Handshake – AUTH and SELECT are pipelined,
+     * so that they cost a single round trip */
+    if (password && password[0] != '\0')
+        redisAppendCommand(*rc, "AUTH %b", password, (size_t)strlen(password));
+    if (db_index)
+        redisAppendCommand(*rc, "SELECT %d", db_index);
+
     /* Authenticate */
-    if (password) {
-        if (!auth(rc, password)) {
+    if (password && password[0] != '\0') {
+        if (REDIS_OK != redisGetReply(*rc, (void **) &reply))
+            reply = NULL;
+        if (reply == NULL || reply->type == REDIS_REPLY_ERROR) {
+            if (reply) {
+                zwarn("Error when authenticating (%s)", reply->str);
+                freeReplyObject(reply);
+            } else {
+                zwarn("Error when authenticating (no connection?)");
+            }
             // redisFree(*rc);
             // *rc = NULL;
             return 0;
         }
+        freeReplyObject(reply);
+        reply = NULL;
     }
 
     /* Select database */
     if (db_index) {
-        reply = redisCommand(*rc, "SELECT %d", db_index);
+        if (REDIS_OK != redisGetReply(*rc, (void **) &reply))
+            reply = NULL;
         if (reply == NULL || reply->type == REDIS_REPLY_ERROR) {
             if (reply) {
                 zwarn("error selecting database #%d (host: %s:%d, message: %s)", db_index, host, port, reply->str);
@@ -3652,11 +3922,15 @@ connect(redisContext **rc, const char* password, const char *host, int port, int
 /* FUNCTION: type {{{ */
 
 static int
-type(redisContext **rc, int *fdesc, const char *redis_host_port, const char *password, char *key, size_t key_len)
+type(struct redis_conn *conn, char *key, size_t key_len)
 {
+    redisContext **rc = &conn->rc;
     redisReply *reply = NULL;
     int tpe;
 
+    /* Own connection in forked child */
+    conn_rc(conn);
+
     int retry = 0;
  retry:
     if (*rc) {
@@ -3682,7 +3956,7 @@ type(redisContext **rc, int *fdesc, const char *redis_host_port, const char *pas
             return DB_KEY_TYPE_UNKNOWN;
         }
         retry = 1;
-        if(reconnect(rc, fdesc, redis_host_port, password))
+        if(conn_reconnect(conn))
             goto retry;
         else
             return DB_KEY_TYPE_UNKNOWN;
@@ -3722,33 +3996,6 @@ type_from_string(const char *string, int len)
     return DB_KEY_TYPE_UNKNOWN;
 }
 /* }}} */
-/* FUNCTION: auth {{{ */
-
-static int
-auth(redisContext **rc, const char *password)
-{
-    redisReply *reply = NULL;
-
-    if (!password || password[0] == '\0')
-        return 1;
-
-    if (!*rc)
-        return 1;
-
-    reply = redisCommand(*rc, "AUTH %b", password, (size_t)strlen(password));
-    if (reply == NULL || reply->type == REDIS_REPLY_ERROR) {
-        if (reply) {
-            zwarn("Error when authenticating (%s)", reply->str);
-            freeReplyObject(reply);
-        } else {
-            zwarn("Error when authenticating (no connection?)");
-        }
-        return 0;
-    }
-    freeReplyObject(reply);
-    return 1;
-}
-/* }}} */
 /* FUNCTION: is_tied {{{ */
 
 static int
@@ -3775,22 +4022,36 @@ is_tied(Param pm)
 
 /**/
 static void
-zrzset_usage()
+zrzset_usage(void)
 {
     fprintf(stdout, "Usage: zrzset {tied-param-name}\n");
     fprintf(stdout, "Output: $reply array, to hold elements of the sorted set\n");
     fflush(stdout);
 }
 /* }}} */
-/* FUNCTION: zrpush_usage {{{ */
+/* FUNCTION: zrlrange_usage {{{ */
 
 /**/
 static void
-zrpush_usage()
+zrlrange_usage(void)
 {
-    fprintf(stdout, "Usage: zrpush {l|r} {tied-param-name} {value}\n");
-    fprintf(stdout, "Usage: zrpush {l|r} {tied-param-name} [ {value1} {value2} ... ]\n");
-    fprintf(stdout, "Usage: zrpush {l|r} {tied-param-name} {value1} {value2} ...\n");
+    fprintf(stdout, "Usage: zrlrange {tied-param-name} {index}\n");
+    fprintf(stdout, "Usage: zrlrange {tied-param-name} {start} {end}\n");
+    fprintf(stdout, "Output: $reply array, to hold element(s) of the list, as $list[index]\n");
+    fprintf(stdout, "or $list[start,end] would, but without fetching the whole list;\n");
+    fprintf(stdout, "the fetched window is cached, repeated reads within it are local\n");
+    fflush(stdout);
+}
+/* }}} */
+/* FUNCTION: zrpush_usage {{{ */
+
+/**/
+static void
+zrpush_usage(void)
+{
+    fprintf(stdout, "Usage: zrpush {l|r} {tied-param-name} {value}\n");
+    fprintf(stdout, "Usage: zrpush {l|r} {tied-param-name} [ {value1} {value2} ... ]\n");
+    fprintf(stdout, "Usage: zrpush {l|r} {tied-param-name} {value1} {value2} ...\n");
     fprintf(stdout, "Usage: zrpush {l|r} [ {value1} {value2} ... ]\n");
     fprintf(stdout, "The function LPUSHes or RPUSHes given element(s) onto the list\n");
     fprintf(stdout, "{tied-param-name}. The last form takes the param-name from the special\n");
@@ -3798,24 +4059,21 @@ zrpush_usage()
     fflush(stdout);
 }
 /* }}} */
-/* FUNCTION: reconnect {{{ */
+/* FUNCTION: reconnect_to {{{ */
 
 static int
-reconnect(redisContext **rc, int *fdesc, const char *hostspec_in, const char *password)
+reconnect_to(redisContext **rc, int *fdesc, const char *host, int port, int db_index,
+             const char *password, const char *address, int timeout_ms)
 {
-    char hostspec[192];
-    char *host="127.0.0.1", *key="";
-    int port = 6379, db_index = 0;
-
-    parse_host_string(hostspec_in, hostspec, 192, &host, &port, &db_index, &key);
-
     if (*rc)
         redisFree(*rc);
     *rc = NULL;
 
     fdtable[*fdesc] = FDT_UNUSED;
 
-    if(!connect(rc, password, host, port, db_index, hostspec_in)) {
+    if(!connect(rc, password, host, port, db_index, address, timeout_ms)) {
+        if (*rc)
+            redisFree(*rc);
         *rc = NULL;
         zwarn("Not connected, retrying... Failed, aborting");
         return 0;
@@ -3827,26 +4085,1741 @@ reconnect(redisContext **rc, int *fdesc, const char *hostspec_in, const char *pa
     }
 }
 /* }}} */
-/* FUNCTION: get_from_hash {{{ */
+/* FUNCTION: conn_acquire {{{ */
 
-char *
-get_from_hash(Param pm, const char *key)
+/*
+ * Returns pooled connection for given server and database,
+ * creating it if needed. With `do_connect`, a connection
+ * that isn't yet established is connected. NULL is returned
+ * when connecting fails (error is already reported). Timeouts
+ * given in `topts` apply to the whole shared connection.
+ */
+
+static struct redis_conn *
+conn_acquire(const char *host, int port, int db_index, const char *password,
+             const char *address, int do_connect, const struct tie_options *topts)
 {
-    HashTable ht = pm->u.hash;
-    if (!ht) {
-        return NULL;
+    struct redis_conn *conn;
+    char hostspec[256];
+
+    if (port < 0)
+        snprintf(hostspec, sizeof(hostspec), "unix:%s/%d", host, db_index);
+    else
+        snprintf(hostspec, sizeof(hostspec), "%s:%d/%d", host, port, db_index);
+
+    for (conn = conn_pool; conn; conn = conn->next) {
+        if (0 == strcmp(conn->hostspec, hostspec) &&
+            ((!conn->password && !password) ||
+             (conn->password && password && 0 == strcmp(conn->password, password))))
+        {
+            break;
+        }
     }
 
-    /* Get hash element */
-    HashNode hn = gethashnode2(ht, key);
-    Param val_pm = (Param) hn;
+    if (!conn) {
+        conn = (struct redis_conn *) zshcalloc(sizeof(struct redis_conn));
+        conn->hostspec = ztrdup(hostspec);
+        conn->host = ztrdup(host);
+        conn->port = port;
+        conn->db_index = db_index;
+        conn->password = password ? ztrdup(password) : NULL;
+        conn->timeout_ms = ZREDIS_DEFAULT_TIMEOUT;
+        conn->backoff_ms = ZREDIS_DEFAULT_BACKOFF;
+        conn->pid = getpid();
+        conn->pooled = 1;
+        conn->next = conn_pool;
+        conn_pool = conn;
+    }
+    conn->refs ++;
 
-    if (!val_pm) {
-        return NULL;
+    /* Tie in a subshell doesn't reuse parent's socket */
+    conn_forked(conn);
+
+    if (topts->timeout_ms)
+        conn->timeout_ms = topts->timeout_ms;
+    if (topts->backoff_ms)
+        conn->backoff_ms = topts->backoff_ms;
+
+    if (do_connect && !conn->rc) {
+        if (!connect(&conn->rc, password, host, port, db_index, address, conn->timeout_ms)) {
+            if (conn->rc) {
+                redisFree(conn->rc);
+                conn->rc = NULL;
+            }
+            conn_release(conn);
+            return NULL;
+        }
+        conn->fdesc = conn->rc->fd;
+        addmodulefd(conn->fdesc, FDT_INTERNAL);
     }
 
-    /* Fill hash element */
-    return val_pm->gsu.s->getfn(val_pm);
+    return conn;
+}
+/* }}} */
+/* FUNCTION: conn_release {{{ */
+
+/* Drops reference, closes connection when it was the last one */
+
+static void
+conn_release(struct redis_conn *conn)
+{
+    struct redis_conn **prev;
+
+    if (!conn || --conn->refs > 0)
+        return;
+
+    conn_forked(conn);
+    conn_track_stop(conn);
+    while (conn->tracked) {
+        struct tracked_tie *tt = conn->tracked;
+        conn->tracked = tt->next;
+        zfree(tt, sizeof(struct tracked_tie));
+    }
+    if (conn->rc) {
+        redisFree(conn->rc);
+        conn->rc = NULL;
+        fdtable[conn->fdesc] = FDT_UNUSED;
+    }
+
+    if (conn->pooled) {
+        for (prev = &conn_pool; *prev; prev = &(*prev)->next) {
+            if (*prev == conn) {
+                *prev = conn->next;
+                break;
+            }
+        }
+    }
+
+    zsfree(conn->hostspec);
+    zsfree(conn->host);
+    if (conn->password)
+        zsfree(conn->password);
+    zfree(conn, sizeof(struct redis_conn));
+}
+/* }}} */
+/* FUNCTION: conn_detach {{{ */
+
+/*
+ * Untie: replaces the shared connection with a private,
+ * not connected one, keeping the address – like a closed
+ * own connection
+ */
+
+static void
+conn_detach(struct redis_conn **connp)
+{
+    struct redis_conn *old = *connp, *conn;
+    struct tracked_tie **ttp, *tt;
+
+    /* The tie no longer receives invalidations */
+    for (ttp = &old->tracked; *ttp; ) {
+        if ((*ttp)->connp == connp) {
+            tt = *ttp;
+            *ttp = tt->next;
+            zfree(tt, sizeof(struct tracked_tie));
+        } else {
+            ttp = &(*ttp)->next;
+        }
+    }
+    if (!old->tracked && old->inval_rc && old->refs > 1) {
+        conn_track_stop(old);
+        if (old->rc && old->pid == getpid()) {
+            redisReply *reply = redisCommand(old->rc, "CLIENT TRACKING off");
+            if (reply)
+                freeReplyObject(reply);
+        }
+    }
+
+    conn = (struct redis_conn *) zshcalloc(sizeof(struct redis_conn));
+    conn->hostspec = ztrdup(old->hostspec);
+    conn->host = ztrdup(old->host);
+    conn->port = old->port;
+    conn->db_index = old->db_index;
+    conn->password = old->password ? ztrdup(old->password) : NULL;
+    conn->scan_type = old->scan_type;
+    conn->timeout_ms = old->timeout_ms;
+    conn->backoff_ms = old->backoff_ms;
+    conn->pid = getpid();
+    conn->refs = 1;
+
+    *connp = conn;
+    conn_release(old);
+}
+/* }}} */
+/* FUNCTION: conn_reconnect {{{ */
+
+/*
+ * Circuit breaker: after a failed reconnect, next attempts
+ * are refused without any network activity until the backoff
+ * window passes. The window doubles with each consecutive
+ * failure, up to conn->backoff_ms. Getters then return the
+ * last known values.
+ */
+
+static int
+conn_reconnect(struct redis_conn *conn)
+{
+    long long now = now_ms(), wait;
+
+    if (conn->failures && now < conn->retry_after)
+        return 0;
+
+    if (reconnect_to(&conn->rc, &conn->fdesc, conn->host, conn->port, conn->db_index,
+                     conn->password, conn->hostspec, conn->timeout_ms))
+    {
+        conn->failures = 0;
+        /* Invalidations sent meanwhile are lost */
+        if (conn->tracked) {
+            conn_invalidate(conn, NULL, 0);
+            conn_track_start(conn);
+        }
+        return 1;
+    }
+
+    wait = ZREDIS_BACKOFF_START;
+    if (conn->failures < 16)
+        wait <<= conn->failures;
+    else
+        wait = conn->backoff_ms;
+    if (wait > conn->backoff_ms)
+        wait = conn->backoff_ms;
+
+    conn->failures ++;
+    conn->retry_after = now_ms() + wait;
+    return 0;
+}
+/* }}} */
+/* FUNCTION: conn_forked {{{ */
+
+/*
+ * After fork (subshell, $(...), pipeline, &) the child
+ * inherits parent's context – both processes would then
+ * read and write the same socket and take each other's
+ * replies. The child drops the context without touching
+ * the stream: fd is detached from the context, so that
+ * redisFree() doesn't close it, and is closed only if zsh
+ * still has it registered (forked builtins close internal
+ * fds and the number can be reused). Returns 1 if parent's
+ * context has been dropped.
+ */
+
+static int
+conn_forked(struct redis_conn *conn)
+{
+    if (conn->pid == getpid())
+        return 0;
+
+    conn->pid = getpid();
+    conn->failures = 0;
+
+    if (conn->inval_rc) {
+        /* Parent's subscriber – detached like rc below */
+        if (conn->inval_fdesc == conn->inval_rc->fd && fdtable[conn->inval_fdesc] == FDT_INTERNAL)
+            zclose(conn->inval_fdesc);
+        conn->inval_rc->fd = -1;
+        redisFree(conn->inval_rc);
+        conn->inval_rc = NULL;
+        /* Parent's invalidations won't reach the child */
+        conn_invalidate(conn, NULL, 0);
+    }
+
+    if (!conn->rc)
+        return 0;
+
+    if (conn->fdesc == conn->rc->fd && fdtable[conn->fdesc] == FDT_INTERNAL)
+        zclose(conn->fdesc);
+    conn->rc->fd = -1;
+    redisFree(conn->rc);
+    conn->rc = NULL;
+    return 1;
+}
+/* }}} */
+/* FUNCTION: conn_rc {{{ */
+
+/*
+ * Context to use for a command. In a forked child it's
+ * a new connection, made on first use – quietly, unlike
+ * reconnect after connection loss. If it fails, callers'
+ * reconnect sees the backoff window and fails fast.
+ */
+
+static redisContext *
+conn_rc(struct redis_conn *conn)
+{
+    if (!conn_forked(conn))
+        return conn->rc;
+
+    if (connect(&conn->rc, conn->password, conn->host, conn->port, conn->db_index,
+                conn->hostspec, conn->timeout_ms))
+    {
+        conn->fdesc = conn->rc->fd;
+        addmodulefd(conn->fdesc, FDT_INTERNAL);
+        if (conn->tracked)
+            conn_track_start(conn);
+    } else {
+        if (conn->rc)
+            redisFree(conn->rc);
+        conn->rc = NULL;
+        conn->failures = 1;
+        conn->retry_after = now_ms() + ZREDIS_BACKOFF_START;
+    }
+
+    return conn->rc;
+}
+/* }}} */
+/* FUNCTION: conn_track {{{ */
+
+/*
+ * Registers tied parameter for server-assisted invalidation
+ * (-o track) and enables it on the connection. Lazy, not yet
+ * connected tie gets it enabled on (re)connect.
+ */
+
+static void
+conn_track(Param pm)
+{
+    struct redis_conn **connp;
+    struct tracked_tie *tt;
+
+    tt = (struct tracked_tie *) zshcalloc(sizeof(struct tracked_tie));
+    tt->pm = pm;
+
+    if (pm->gsu.h == &redis_hash_gsu || pm->gsu.h == &hash_zset_gsu || pm->gsu.h == &hash_hset_gsu) {
+        struct gsu_scalar_ext *gsu_ext = (struct gsu_scalar_ext *) pm->u.hash->tmpdata;
+        connp = &gsu_ext->conn;
+        tt->type = gsu_ext->type;
+        tt->key = gsu_ext->key;
+        tt->key_len = gsu_ext->key_len;
+    } else if (pm->gsu.s->getfn == &redis_str_getfn) {
+        struct gsu_scalar_ext *gsu_ext = (struct gsu_scalar_ext *) pm->gsu.s;
+        connp = &gsu_ext->conn;
+        tt->type = gsu_ext->type;
+        tt->key = gsu_ext->key;
+        tt->key_len = gsu_ext->key_len;
+    } else {
+        struct gsu_array_ext *gsu_ext = (struct gsu_array_ext *) pm->gsu.a;
+        connp = &gsu_ext->conn;
+        tt->type = gsu_ext->type;
+        tt->key = gsu_ext->key;
+        tt->key_len = gsu_ext->key_len;
+    }
+
+    tt->connp = connp;
+    tt->next = (*connp)->tracked;
+    (*connp)->tracked = tt;
+
+    if ((*connp)->rc && !(*connp)->inval_rc)
+        conn_track_start(*connp);
+}
+/* }}} */
+/* FUNCTION: conn_track_start {{{ */
+
+/*
+ * RESP2 clients get invalidation messages through a second
+ * connection subscribed to __redis__:invalidate, to which
+ * CLIENT TRACKING of the main one is redirected. No NOLOOP:
+ * the connection is shared by ties that may cache the same
+ * key, own writes have to invalidate the other ties (writing
+ * tie doesn't keep the value cached). The subscriber's socket is
+ * non-blocking, conn_poll_invalidations() reads whatever has
+ * arrived without waiting. Returns 1 when tracking is on.
+ */
+
+static int
+conn_track_start(struct redis_conn *conn)
+{
+    redisReply *reply;
+    long long id;
+    long mode;
+
+    conn_track_stop(conn);
+    if (!conn->rc || conn->tracking < 0)
+        return 0;
+
+    /* Server unreachable – inside the reconnect backoff window */
+    if (conn->failures && now_ms() < conn->retry_after)
+        return 0;
+
+    if (!connect(&conn->inval_rc, conn->password, conn->host, conn->port, conn->db_index,
+                 conn->hostspec, conn->timeout_ms))
+    {
+        if (!conn->failures)
+            conn->failures = 1;
+        conn->retry_after = now_ms() + ZREDIS_BACKOFF_START;
+        goto failed;
+    }
+
+    reply = redisCommand(conn->inval_rc, "CLIENT ID");
+    if (!reply || reply->type != REDIS_REPLY_INTEGER) {
+        if (reply && reply->type == REDIS_REPLY_ERROR)
+            conn->tracking = -1;
+        goto failed_reply;
+    }
+    id = reply->integer;
+    freeReplyObject(reply);
+
+    reply = redisCommand(conn->inval_rc, "SUBSCRIBE __redis__:invalidate");
+    if (!reply || reply->type != REDIS_REPLY_ARRAY)
+        goto failed_reply;
+    freeReplyObject(reply);
+
+    reply = redisCommand(conn->rc, "CLIENT TRACKING on REDIRECT %lld", id);
+    if (!reply || reply->type == REDIS_REPLY_ERROR) {
+        if (reply)
+            conn->tracking = -1;
+        goto failed_reply;
+    }
+    freeReplyObject(reply);
+
+    conn->inval_fdesc = conn->inval_rc->fd;
+    setblock_fd(0, conn->inval_fdesc, &mode);
+    conn->inval_rc->flags &= ~REDIS_BLOCK;
+    addmodulefd(conn->inval_fdesc, FDT_INTERNAL);
+    conn->tracking = 1;
+    conn->failures = 0;
+    return 1;
+
+ failed_reply:
+    if (reply) {
+        if (reply->type == REDIS_REPLY_ERROR)
+            zwarn("Cache invalidation not available (%s), -o track ignored", reply->str);
+        freeReplyObject(reply);
+    }
+ failed:
+    if (conn->inval_rc) {
+        redisFree(conn->inval_rc);
+        conn->inval_rc = NULL;
+    }
+    return 0;
+}
+/* }}} */
+/* FUNCTION: conn_track_stop {{{ */
+
+static void
+conn_track_stop(struct redis_conn *conn)
+{
+    if (conn->inval_rc) {
+        redisFree(conn->inval_rc);
+        conn->inval_rc = NULL;
+        fdtable[conn->inval_fdesc] = FDT_UNUSED;
+    }
+}
+/* }}} */
+/* FUNCTION: conn_invalidate {{{ */
+
+/*
+ * Clears PM_UPTODATE of cached data of `key` in all tracked
+ * ties of the connection. NULL key means everything (FLUSHDB,
+ * or invalidations might have been lost).
+ */
+
+static void
+conn_invalidate(struct redis_conn *conn, const char *key, size_t key_len)
+{
+    struct tracked_tie *tt;
+    char *mkey = NULL;
+    HashTable ht;
+    HashNode hn;
+    int i;
+
+    if (key)
+        mkey = metafy((char *) key, key_len, META_USEHEAP);
+
+    for (tt = conn->tracked; tt; tt = tt->next) {
+        if (tt->type == DB_KEY_TYPE_NO_KEY && key) {
+            /* Whole-db hash – key is a field */
+            if ((hn = gethashnode2(tt->pm->u.hash, mkey)))
+                ((Param) hn)->node.flags &= ~(PM_UPTODATE);
+        } else if (key && (tt->key_len != key_len || 0 != memcmp(tt->key, key, key_len))) {
+            continue;
+        } else if (tt->type == DB_KEY_TYPE_STRING || tt->type == DB_KEY_TYPE_SET ||
+                   tt->type == DB_KEY_TYPE_LIST) {
+            tt->pm->node.flags &= ~(PM_UPTODATE);
+            if (tt->type == DB_KEY_TYPE_LIST)
+                list_window_drop((struct gsu_array_ext *) tt->pm->gsu.a);
+        } else {
+            ht = tt->pm->u.hash;
+            for (i = 0; i < ht->hsize; i++) {
+                for (hn = ht->nodes[i]; hn; hn = hn->next)
+                    ((Param) hn)->node.flags &= ~(PM_UPTODATE);
+            }
+        }
+    }
+}
+/* }}} */
+/* FUNCTION: conn_poll_invalidations {{{ */
+
+/*
+ * Called before cached data is used. Reads invalidation
+ * messages that have arrived, doesn't block. If the channel
+ * is broken, whole cache is dropped and tracking restarted.
+ */
+
+static void
+conn_poll_invalidations(struct redis_conn *conn)
+{
+    redisReply *reply, *keys;
+    void *ptr;
+    int j;
+
+    if (!conn->tracked)
+        return;
+
+    /* Forked child gets own connections */
+    conn_rc(conn);
+
+    if (!conn->inval_rc) {
+        if (conn->rc && conn->tracking >= 0) {
+            conn_invalidate(conn, NULL, 0);
+            conn_track_start(conn);
+        }
+        return;
+    }
+
+    if (REDIS_OK != redisBufferRead(conn->inval_rc)) {
+        conn_invalidate(conn, NULL, 0);
+        conn_track_start(conn);
+        return;
+    }
+
+    while (REDIS_OK == redisGetReplyFromReader(conn->inval_rc, &ptr) && ptr) {
+        reply = (redisReply *) ptr;
+        /* [ "message", "__redis__:invalidate", [ keys ] or nil ] */
+        if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 3 &&
+            reply->element[0]->type == REDIS_REPLY_STRING &&
+            reply->element[0]->len == 7 && 0 == strncmp(reply->element[0]->str, "message", 7))
+        {
+            keys = reply->element[2];
+            if (keys->type == REDIS_REPLY_ARRAY) {
+                for (j = 0; j < keys->elements; j++) {
+                    if (keys->element[j]->type == REDIS_REPLY_STRING)
+                        conn_invalidate(conn, keys->element[j]->str, keys->element[j]->len);
+                }
+            } else {
+                conn_invalidate(conn, NULL, 0);
+            }
+        }
+        freeReplyObject(reply);
+    }
+}
+/* }}} */
+/* FUNCTION: cache_expire {{{ */
+
+/*
+ * -o ttl: once per ttl_ms, on first access after that time,
+ * cached data of the tie are marked out of date – the element
+ * Params of hash `ht`, or `pm` itself. A value is thus never
+ * older than ttl_ms, and repeated reads in between are free.
+ */
+
+static void
+cache_expire(Param pm, HashTable ht, int ttl_ms, long long *expires)
+{
+    long long now;
+    HashNode hn;
+    int i;
+
+    if (!ttl_ms)
+        return;
+
+    now = now_ms();
+    if (now < *expires)
+        return;
+    *expires = now + ttl_ms;
+
+    if (ht) {
+        for (i = 0; i < ht->hsize; i++) {
+            for (hn = ht->nodes[i]; hn; hn = hn->next)
+                ((Param) hn)->node.flags &= ~(PM_UPTODATE);
+        }
+    } else if (pm) {
+        pm->node.flags &= ~(PM_UPTODATE);
+    }
+}
+/* }}} */
+/* FUNCTION: cache_evict {{{ */
+
+/*
+ * -o cache={n}: keeps at most n element Params in hash `ht`,
+ * freeing the least recently used ones together with their
+ * cached values. LRU is approximated with the CLOCK algorithm:
+ * a hand goes over the hash buckets, an element accessed since
+ * its previous pass (PM_RECENT) gets a second chance. `keep`
+ * (the element being accessed) is never freed.
+ */
+
+static void
+cache_evict(HashTable ht, struct gsu_scalar_ext *gsu_ext, HashNode keep)
+{
+    HashNode hn, next;
+    int limit = gsu_ext->opts.cache_max, steps, saved;
+
+    if (!limit || gsu_ext->scanning || ht->ct <= limit)
+        return;
+
+    queue_signals();
+
+    /* Only the cache is freed, not the database keys */
+    saved = no_database_action;
+    no_database_action = 1;
+
+    /* Two rounds at most: the first one can only clear PM_RECENT */
+    for (steps = 0; ht->ct > limit && steps <= 2 * ht->hsize; steps ++) {
+        if (gsu_ext->evict_hand >= ht->hsize)
+            gsu_ext->evict_hand = 0;
+
+        for (hn = ht->nodes[gsu_ext->evict_hand]; hn && ht->ct > limit; hn = next) {
+            next = hn->next;
+            if (hn == keep)
+                continue;
+            if (hn->flags & PM_RECENT) {
+                hn->flags &= ~(PM_RECENT);
+            } else {
+                ht->removenode(ht, hn->nam);
+                ht->freenode(hn);
+            }
+        }
+
+        gsu_ext->evict_hand ++;
+    }
+
+    no_database_action = saved;
+    unqueue_signals();
+}
+/* }}} */
+/* FUNCTION: cache_missing {{{ */
+
+/*
+ * Negative cache: hash element that the database doesn't have
+ * is marked PM_UPTODATE with NULL u.str, so that next reads
+ * (e.g. ${dbase[key]:-default} in a loop) don't query the
+ * server. Local write, ztclear, -o ttl and -o track clear the
+ * mark like any cached value. Bounded by -o negcache= – when
+ * the count of marked elements reaches it, they're counted
+ * again (some might have got values) and if there are still
+ * too many, all the marks are dropped.
+ */
+
+static void
+cache_missing(Param pm, struct gsu_scalar_ext *gsu_ext)
+{
+    HashTable ht = gsu_ext->ht;
+    HashNode hn;
+    Param epm;
+    int i, count, clear;
+
+    if (!gsu_ext->use_cache || !gsu_ext->opts.negcache_max || !ht)
+        return;
+
+    if (gsu_ext->neg_count >= gsu_ext->opts.negcache_max) {
+        for (clear = 0; clear < 2; clear ++) {
+            count = 0;
+            for (i = 0; i < ht->hsize; i++) {
+                for (hn = ht->nodes[i]; hn; hn = hn->next) {
+                    epm = (Param) hn;
+                    if ((epm->node.flags & PM_UPTODATE) && !epm->u.str) {
+                        if (clear)
+                            epm->node.flags &= ~(PM_UPTODATE);
+                        else
+                            count ++;
+                    }
+                }
+            }
+            if (count < gsu_ext->opts.negcache_max)
+                break;
+        }
+        gsu_ext->neg_count = clear ? 0 : count;
+    }
+
+    if (pm->u.str) {
+        zsfree(pm->u.str);
+        pm->u.str = NULL;
+    }
+    pm->node.flags |= PM_UPTODATE;
+    gsu_ext->neg_count ++;
+}
+/* }}} */
+/* FUNCTION: now_ms {{{ */
+
+static long long
+now_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (long long) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+/* }}} */
+/* FUNCTION: get_from_hash {{{ */
+
+char *
+get_from_hash(Param pm, const char *key)
+{
+    HashTable ht = pm->u.hash;
+    if (!ht) {
+        return NULL;
+    }
+
+    /* Get hash element */
+    HashNode hn = gethashnode2(ht, key);
+    Param val_pm = (Param) hn;
+
+    if (!val_pm) {
+        return NULL;
+    }
+
+    /* Fill hash element */
+    return val_pm->gsu.s->getfn(val_pm);
+}
+/* }}} */
+/* FUNCTION: tie_option_number {{{ */
+
+/*
+ * Converts value of -o {name}={value} entry to a number
+ * not smaller than `min`. Whole value has to be a number,
+ * otherwise warns with `what` (the expected value) and
+ * returns 0.
+ */
+
+static int
+tie_option_number(const char *name, const char *value, long min, const char *what, int *out)
+{
+    char *eptr;
+    long num;
+
+    if (value && *value) {
+        errno = 0;
+        num = strtol(value, &eptr, 10);
+        if (!*eptr && !errno && num >= min && num <= INT_MAX) {
+            *out = (int) num;
+            return 1;
+        }
+    }
+
+    zwarnnam("ztie", "-o %s= requires %s, got: `%s'", name, what, value ? value : "");
+    return 0;
+}
+/* }}} */
+/* FUNCTION: tie_option_flag {{{ */
+
+/* -o {name} or {name}=0/1 */
+
+static int
+tie_option_flag(const char *name, const char *value, int *out)
+{
+    if (!value) {
+        *out = 1;
+        return 1;
+    }
+    if (!tie_option_number(name, value, 0, "0 or 1", out))
+        return 0;
+    *out = (*out != 0);
+    return 1;
+}
+/* }}} */
+/* FUNCTION: parse_tie_options {{{ */
+
+/*
+ * Parses -o argument of ztie: comma-separated list
+ * of {name}[={value}] entries. Fills defaults first.
+ */
+
+static int
+parse_tie_options(const char *spec, struct tie_options *topts)
+{
+    char *buf, *entry, *next, *value;
+
+    topts->batch_size = ZREDIS_DEFAULT_BATCH;
+    topts->diff = 0;
+    topts->rename = 0;
+    topts->lua = 0;
+    topts->timeout_ms = 0;
+    topts->backoff_ms = 0;
+    topts->track = 0;
+    topts->ttl_ms = 0;
+    topts->cache_max = 0;
+    topts->negcache_max = ZREDIS_DEFAULT_NEGCACHE;
+
+    if (!spec || spec[0] == '\0')
+        return 1;
+
+    buf = dupstring(spec);
+
+    for (entry = buf; entry; entry = next) {
+        if ((next = strchr(entry, ',')))
+            *next++ = '\0';
+        if (entry[0] == '\0')
+            continue;
+
+        if ((value = strchr(entry, '=')))
+            *value++ = '\0';
+
+        if (0 == strcmp(entry, "batch")) {
+            if (!tie_option_number(entry, value, 1, "a positive number", &topts->batch_size))
+                return 0;
+        } else if (0 == strcmp(entry, "timeout")) {
+            if (!tie_option_number(entry, value, 1, "a positive number of milliseconds", &topts->timeout_ms))
+                return 0;
+        } else if (0 == strcmp(entry, "backoff")) {
+            if (!tie_option_number(entry, value, 1, "a positive number of milliseconds", &topts->backoff_ms))
+                return 0;
+        } else if (0 == strcmp(entry, "ttl")) {
+            if (!tie_option_number(entry, value, 1, "a positive number of milliseconds", &topts->ttl_ms))
+                return 0;
+        } else if (0 == strcmp(entry, "cache")) {
+            if (!tie_option_number(entry, value, 1, "a positive number of elements", &topts->cache_max))
+                return 0;
+        } else if (0 == strcmp(entry, "negcache")) {
+            if (!tie_option_number(entry, value, 0, "a number of elements (0 disables)", &topts->negcache_max))
+                return 0;
+        } else if (0 == strcmp(entry, "diff")) {
+            if (!tie_option_flag(entry, value, &topts->diff))
+                return 0;
+        } else if (0 == strcmp(entry, "rename")) {
+            if (!tie_option_flag(entry, value, &topts->rename))
+                return 0;
+        } else if (0 == strcmp(entry, "lua")) {
+            if (!tie_option_flag(entry, value, &topts->lua))
+                return 0;
+        } else if (0 == strcmp(entry, "track")) {
+            if (!tie_option_flag(entry, value, &topts->track))
+                return 0;
+        } else {
+            zwarnnam("ztie", "unknown -o option: `%s'", entry);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+/* }}} */
+/* FUNCTION: rargv_init {{{ */
+
+static void
+rargv_init(struct redis_argv *ra)
+{
+    ra->alloced = 16;
+    ra->argv = (char **) zalloc(ra->alloced * sizeof(char *));
+    ra->lens = (size_t *) zalloc(ra->alloced * sizeof(size_t));
+    ra->argc = 0;
+    ra->fixed = 0;
+}
+/* }}} */
+/* FUNCTION: rargv_add {{{ */
+
+/* Appends copy of given binary-safe string */
+
+static void
+rargv_add(struct redis_argv *ra, const char *str, size_t len)
+{
+    if (ra->argc == ra->alloced) {
+        int new_size = ra->alloced * 2;
+        char **new_argv = (char **) zalloc(new_size * sizeof(char *));
+        size_t *new_lens = (size_t *) zalloc(new_size * sizeof(size_t));
+
+        memcpy(new_argv, ra->argv, ra->argc * sizeof(char *));
+        memcpy(new_lens, ra->lens, ra->argc * sizeof(size_t));
+        zfree(ra->argv, ra->alloced * sizeof(char *));
+        zfree(ra->lens, ra->alloced * sizeof(size_t));
+
+        ra->argv = new_argv;
+        ra->lens = new_lens;
+        ra->alloced = new_size;
+    }
+
+    ra->argv[ra->argc] = (char *) zalloc(len + 1);
+    memcpy(ra->argv[ra->argc], str, len);
+    ra->argv[ra->argc][len] = '\0';
+    ra->lens[ra->argc] = len;
+    ra->argc ++;
+}
+/* }}} */
+/* FUNCTION: rargv_add_meta {{{ */
+
+/* Appends unmetafied copy of Zsh string */
+
+static void
+rargv_add_meta(struct redis_argv *ra, const char *zstr)
+{
+    int umlen = 0;
+    char *umval = zsh_db_unmetafy_zalloc(zstr, &umlen);
+
+    rargv_add(ra, umval, umlen);
+
+    zsh_db_set_length(umval, umlen);
+    zsfree(umval);
+}
+/* }}} */
+/* FUNCTION: rargv_flush {{{ */
+
+/*
+ * Appends the command to the output buffer of `rc` (no
+ * round trip yet) and drops the non-fixed arguments, so
+ * that next chunk can be collected. Returns 1 if a command
+ * was appended, to be counted for drain_replies().
+ */
+
+static int
+rargv_flush(redisContext *rc, struct redis_argv *ra)
+{
+    int i, appended = 0;
+
+    if (ra->argc > ra->fixed) {
+        if (REDIS_OK == redisAppendCommandArgv(rc, ra->argc, (const char **) ra->argv, ra->lens))
+            appended = 1;
+        else
+            zwarn("Out of memory when preparing bulk command");
+    }
+
+    /* Length + 1, as in zsfree() */
+    for (i = ra->fixed; i < ra->argc; i++)
+        zfree(ra->argv[i], ra->lens[i] + 1);
+    ra->argc = ra->fixed;
+
+    return appended;
+}
+/* }}} */
+/* FUNCTION: rargv_set {{{ */
+
+/* Replaces i-th argument with copy of given string */
+
+static void
+rargv_set(struct redis_argv *ra, int i, const char *str, size_t len)
+{
+    zfree(ra->argv[i], ra->lens[i] + 1);
+    ra->argv[i] = (char *) zalloc(len + 1);
+    memcpy(ra->argv[i], str, len);
+    ra->argv[i][len] = '\0';
+    ra->lens[i] = len;
+}
+/* }}} */
+/* FUNCTION: rargv_free {{{ */
+
+static void
+rargv_free(struct redis_argv *ra)
+{
+    int i;
+    for (i = 0; i < ra->argc; i++)
+        zfree(ra->argv[i], ra->lens[i] + 1);
+    zfree(ra->argv, ra->alloced * sizeof(char *));
+    zfree(ra->lens, ra->alloced * sizeof(size_t));
+    ra->argv = NULL;
+    ra->lens = NULL;
+    ra->argc = ra->alloced = ra->fixed = 0;
+}
+/* }}} */
+/* FUNCTION: drain_replies {{{ */
+
+/*
+ * Reads `count` replies of pipelined commands, reports
+ * error replies, also the ones inside EXEC reply. Returns
+ * number of error replies. On
+ * disconnection returns early, `rc->err` is then set.
+ */
+
+static int
+drain_replies(redisContext *rc, int count, const char *cmdname)
+{
+    redisReply *reply;
+    int errors = 0;
+
+    while (count-- > 0) {
+        reply = NULL;
+        if (REDIS_OK != redisGetReply(rc, (void **) &reply)) {
+            if (reply)
+                freeReplyObject(reply);
+            return errors + 1;
+        }
+        if (reply && reply->type == REDIS_REPLY_ERROR) {
+            if (!errors)
+                zwarn("Error reply to %s: %s", cmdname, reply->str ? reply->str : "(no message)");
+            errors ++;
+        } else if (reply && reply->type == REDIS_REPLY_ARRAY) {
+            /* EXEC – errors of the queued commands */
+            size_t j;
+            for (j = 0; j < reply->elements; j++) {
+                redisReply *sub = reply->element[j];
+                if (sub && sub->type == REDIS_REPLY_ERROR) {
+                    if (!errors)
+                        zwarn("Error reply to %s: %s", cmdname, sub->str ? sub->str : "(no message)");
+                    errors ++;
+                }
+            }
+        }
+        if (reply)
+            freeReplyObject(reply);
+    }
+
+    return errors;
+}
+/* }}} */
+/* FUNCTION: append_chunks {{{ */
+
+/*
+ * Appends (without reading replies) variadic `cmd key ...`
+ * commands with at most `batch_size` of the (metafied)
+ * `vals` each. Returns number of appended commands
+ */
+
+static int
+append_chunks(redisContext *rc, const char *cmd, const char *key, size_t key_len,
+              char **vals, int batch_size)
+{
+    struct redis_argv ra;
+    int pending = 0;
+
+    if (!vals || !*vals)
+        return 0;
+
+    rargv_init(&ra);
+    rargv_add(&ra, cmd, strlen(cmd));
+    rargv_add(&ra, key, key_len);
+    ra.fixed = ra.argc;
+
+    for (; *vals; vals++) {
+        rargv_add_meta(&ra, *vals);
+        if (ra.argc - ra.fixed >= batch_size)
+            pending += rargv_flush(rc, &ra);
+    }
+    pending += rargv_flush(rc, &ra);
+    rargv_free(&ra);
+
+    return pending;
+}
+/* }}} */
+/* FUNCTION: replace_members {{{ */
+
+/*
+ * Replaces collection `key` with (metafied) elements of
+ * `vals`, sent as variadic `cmd` (SADD, RPUSH, ...) commands
+ * of at most `batch_size` elements. MULTI, DEL, the chunks
+ * and EXEC go in one pipeline, so readers never see the key
+ * half populated. With -o rename, the collection is built
+ * under a temporary key instead, and RENAMEd over `key` –
+ * that's atomic too, but the server doesn't have to execute
+ * the whole replacement at once (EXEC of a huge transaction
+ * blocks other clients). Returns number of error replies, on
+ * disconnection `rc->err` is set and the replacement can be
+ * retried. With -o lua, single EVALSHA does the replace.
+ */
+
+static int
+replace_members(redisContext *rc, const char *cmd, const char *key, size_t key_len,
+                char **vals, int batch_size, const struct tie_options *topts)
+{
+    int pending = 0, errors;
+
+    if (topts->lua && vals && *vals) {
+        errors = replace_via_script(rc, cmd, key, key_len, vals, batch_size);
+        if (errors >= 0)
+            return errors;
+        /* No scripting on the server – continue normally */
+    }
+
+    if (topts->rename && vals && *vals)
+        return replace_via_rename(rc, cmd, key, key_len, vals, batch_size);
+
+    queue_signals();
+    redisAppendCommand(rc, "MULTI");
+    redisAppendCommand(rc, "DEL %b", key, (size_t) key_len);
+    pending += 2;
+
+    pending += append_chunks(rc, cmd, key, key_len, vals, batch_size);
+
+    redisAppendCommand(rc, "EXEC");
+    pending ++;
+    unqueue_signals();
+
+    return drain_replies(rc, pending, cmd);
+}
+/* }}} */
+/* FUNCTION: replace_via_rename {{{ */
+
+/*
+ * Builds new collection under `{key}:zredis-tmp:{pid}.{id}`
+ * and RENAMEs it over `key`. {id} is the CLIENT ID of the
+ * connection (or a random number on Redis < 5.0), as pid
+ * alone repeats across machines and containers. The temporary
+ * key is given a TTL right after the first chunk, so that it
+ * doesn't stay in the database if the connection is lost;
+ * PERSIST clears the TTL after the RENAME
+ */
+
+static int
+replace_via_rename(redisContext *rc, const char *cmd, const char *key, size_t key_len,
+                   char **vals, int batch_size)
+{
+    struct redis_argv ra;
+    redisReply *reply;
+    char suffix[96], *tmp_key;
+    size_t suffix_len, tmp_len;
+    long long id;
+    int pending = 0, errors, expire_set = 0;
+
+    /* Unique among connections of the server */
+    reply = redisCommand(rc, "CLIENT ID");
+    if (reply && reply->type == REDIS_REPLY_INTEGER)
+        id = reply->integer;
+    else
+        id = ((long long) random() << 31) ^ random() ^ now_ms();
+    if (reply)
+        freeReplyObject(reply);
+
+    sprintf(suffix, ":zredis-tmp:%ld.%lld", (long) getpid(), id);
+    suffix_len = strlen(suffix);
+    tmp_len = key_len + suffix_len;
+    tmp_key = zalloc(tmp_len + 1);
+    memcpy(tmp_key, key, key_len);
+    memcpy(tmp_key + key_len, suffix, suffix_len + 1);
+
+    queue_signals();
+    redisAppendCommand(rc, "DEL %b", tmp_key, tmp_len);
+    pending ++;
+
+    rargv_init(&ra);
+    rargv_add(&ra, cmd, strlen(cmd));
+    rargv_add(&ra, tmp_key, tmp_len);
+    ra.fixed = ra.argc;
+
+    for (; *vals; vals++) {
+        rargv_add_meta(&ra, *vals);
+        if (ra.argc - ra.fixed >= batch_size || !vals[1]) {
+            pending += rargv_flush(rc, &ra);
+            if (!expire_set) {
+                redisAppendCommand(rc, "PEXPIRE %b %d", tmp_key, tmp_len, ZREDIS_TMP_KEY_TTL);
+                pending ++;
+                expire_set = 1;
+            }
+        }
+    }
+    rargv_free(&ra);
+
+    redisAppendCommand(rc, "RENAME %b %b", tmp_key, tmp_len, key, (size_t) key_len);
+    redisAppendCommand(rc, "PERSIST %b", key, (size_t) key_len);
+    pending += 2;
+    unqueue_signals();
+
+    errors = drain_replies(rc, pending, cmd);
+
+    zfree(tmp_key, tmp_len + 1);
+    return errors;
+}
+/* }}} */
+/* FUNCTION: script_sha {{{ */
+
+/*
+ * Returns SHA1 of given script, loading it with SCRIPT LOAD
+ * if it's not yet known or if `reload` is set. NULL means
+ * that scripting isn't available
+ */
+
+static const char *
+script_sha(redisContext *rc, int script, int reload)
+{
+    redisReply *reply;
+
+    if (zr_script_sha[script][0] != '\0' && !reload)
+        return zr_script_sha[script];
+
+    reply = redisCommand(rc, "SCRIPT LOAD %s", zr_scripts[script]);
+    if (reply && reply->type == REDIS_REPLY_STRING && reply->len == 40) {
+        memcpy(zr_script_sha[script], reply->str, 41);
+        freeReplyObject(reply);
+        return zr_script_sha[script];
+    }
+
+    if (reply && reply->type == REDIS_REPLY_ERROR)
+        zwarn("Cannot load server-side script: %s", reply->str);
+    if (reply)
+        freeReplyObject(reply);
+    return NULL;
+}
+/* }}} */
+/* FUNCTION: replace_via_script {{{ */
+
+/*
+ * Replaces collection `key` with one EVALSHA of the replace
+ * script – DEL and the chunks of `cmd` are done server-side.
+ * Returns number of error replies, or -1 if scripting isn't
+ * available (caller should replace in other way)
+ */
+
+static int
+replace_via_script(redisContext *rc, const char *cmd, const char *key, size_t key_len,
+                   char **vals, int batch_size)
+{
+    struct redis_argv ra;
+    redisReply *reply;
+    const char *sha;
+    char step[16];
+    int errors = 0;
+
+    if (!(sha = script_sha(rc, ZR_SCRIPT_REPLACE, 0)))
+        return (rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)) ? 1 : -1;
+
+    /* Even number, so that pairs (ZADD, HSET) aren't split */
+    sprintf(step, "%d", batch_size < ZR_SCRIPT_MAX_STEP ? batch_size : ZR_SCRIPT_MAX_STEP);
+
+    queue_signals();
+    rargv_init(&ra);
+    rargv_add(&ra, "EVALSHA", 7);
+    rargv_add(&ra, sha, 40);
+    rargv_add(&ra, "1", 1);
+    rargv_add(&ra, key, key_len);
+    rargv_add(&ra, cmd, strlen(cmd));
+    rargv_add(&ra, step, strlen(step));
+    for (; *vals; vals++)
+        rargv_add_meta(&ra, *vals);
+
+    reply = redisCommandArgv(rc, ra.argc, (const char **) ra.argv, ra.lens);
+
+    /* Server doesn't know the script – send its body */
+    if (reply && reply->type == REDIS_REPLY_ERROR && 0 == strncmp(reply->str, "NOSCRIPT", 8)) {
+        freeReplyObject(reply);
+        rargv_set(&ra, 0, "EVAL", 4);
+        rargv_set(&ra, 1, zr_scripts[ZR_SCRIPT_REPLACE], strlen(zr_scripts[ZR_SCRIPT_REPLACE]));
+        reply = redisCommandArgv(rc, ra.argc, (const char **) ra.argv, ra.lens);
+    }
+    rargv_free(&ra);
+    unqueue_signals();
+
+    if (!reply || reply->type == REDIS_REPLY_ERROR) {
+        if (reply)
+            zwarn("Error reply to %s script: %s", cmd, reply->str ? reply->str : "(no message)");
+        errors ++;
+    }
+    if (reply)
+        freeReplyObject(reply);
+
+    return errors;
+}
+/* }}} */
+/* FUNCTION: apply_delta {{{ */
+
+/*
+ * Diff mode of whole-value assignment: sends only removals
+ * (`del_cmd` of `dels`, e.g. HDEL, SREM) and additions
+ * (`add_cmd` of `adds`, e.g. HSET, SADD), in one pipeline
+ * that ends with `card_cmd` (HLEN, ...). The delta is
+ * computed from cache, which can miss elements added by
+ * other clients – returns 1 only when the final size is
+ * `expected`, 0 means that full replace is needed.
+ */
+
+static int
+apply_delta(redisContext *rc, const char *key, size_t key_len,
+            const char *del_cmd, char **dels, const char *add_cmd, char **adds,
+            int batch_size, const char *card_cmd, long long expected)
+{
+    redisReply *reply = NULL;
+    int pending = 0, errors, ok;
+
+    queue_signals();
+    if (del_cmd)
+        pending += append_chunks(rc, del_cmd, key, key_len, dels, batch_size);
+    pending += append_chunks(rc, add_cmd, key, key_len, adds, batch_size);
+    redisAppendCommand(rc, "%s %b", card_cmd, key, (size_t) key_len);
+    unqueue_signals();
+
+    /* Read also the `card_cmd` reply when some command failed,
+     * so that the connection isn't left with a stale reply */
+    errors = drain_replies(rc, pending, add_cmd);
+    if (rc->err)
+        return 0;
+
+    if (REDIS_OK != redisGetReply(rc, (void **) &reply)) {
+        if (reply)
+            freeReplyObject(reply);
+        return 0;
+    }
+
+    ok = !errors && reply && reply->type == REDIS_REPLY_INTEGER && reply->integer == expected;
+    if (reply)
+        freeReplyObject(reply);
+
+    return ok;
+}
+/* }}} */
+/* FUNCTION: visit_pairs {{{ */
+
+/*
+ * Calls `func` on element Params for name/value pairs
+ * of a HSCAN, HGETALL, ZSCAN or ZRANGE WITHSCORES reply.
+ * The values are kept in the Params, so that no HGET or
+ * ZSCORE will be needed for them
+ */
+
+static void
+visit_pairs(HashTable ht, redisReply *pairs, GetNodeFunc getnode, ScanFunc func, int flags)
+{
+    struct gsu_scalar_ext *gsu_ext = (struct gsu_scalar_ext *) ht->tmpdata;
+    size_t j;
+
+    for (j = 0; j + 1 < pairs->elements; j += 2) {
+        redisReply *entry = pairs->element[j], *value = pairs->element[j + 1];
+        if (entry == NULL || entry->type != REDIS_REPLY_STRING) {
+            continue;
+        }
+
+        /* This returns database-interfacing Param,
+         * it will return u.str or first fetch data
+         * if not PM_UPTODATE (newly created) */
+        char *zkey = metafy(entry->str, entry->len, META_DUP);
+        HashNode hn = getnode(ht, zkey);
+        zsfree(zkey);
+
+        if (gsu_ext->use_cache && value && value->type == REDIS_REPLY_STRING &&
+            (!(((Param) hn)->node.flags & PM_UPTODATE) || !((Param) hn)->u.str))
+        {
+            cache_elem_value((Param) hn, value->str, value->len);
+        }
+
+        func(hn, flags);
+    }
+}
+/* }}} */
+/* FUNCTION: scan_pairs {{{ */
+
+/*
+ * Iterates a Redis hash or sorted set, calling `func` on
+ * element Params filled with values (or scores). Small
+ * collections (up to -o batch= elements, checked with
+ * `card_cmd`) are fetched whole with `all_cmd`, bigger ones
+ * are read with `scan_cmd` pages, so that a huge reply
+ * isn't built by the server
+ */
+
+/**/
+static void
+scan_pairs(HashTable ht, const char *card_cmd, const char *all_cmd, const char *scan_cmd,
+           GetNodeFunc getnode, ScanFunc func, int flags)
+{
+    char *main_key;
+    size_t main_key_len;
+    unsigned long long cursor = 0;
+    redisContext *rc;
+    redisReply *reply = NULL, *reply2 = NULL;
+    struct gsu_scalar_ext *gsu_ext;
+
+    gsu_ext = (struct gsu_scalar_ext *) ht->tmpdata;
+    main_key = gsu_ext->key;
+    main_key_len = gsu_ext->key_len;
+    cache_expire(NULL, ht, gsu_ext->opts.ttl_ms, &gsu_ext->cache_expires);
+
+    /* Small collection? Fetch it whole */
+    rc = conn_rc(gsu_ext->conn);
+    if (rc) {
+        reply = redisCommand(rc, "%s %b", card_cmd, main_key, (size_t) main_key_len);
+        if (reply && reply->type == REDIS_REPLY_INTEGER &&
+            reply->integer <= (long long) gsu_ext->opts.batch_size)
+        {
+            freeReplyObject(reply);
+            reply = redisCommand(rc, all_cmd, main_key, (size_t) main_key_len);
+            if (reply && reply->type == REDIS_REPLY_ARRAY) {
+                visit_pairs(ht, reply, getnode, func, flags);
+                freeReplyObject(reply);
+                return;
+            }
+        }
+        if (reply)
+            freeReplyObject(reply);
+        reply = NULL;
+    }
+
+    /* Iterate keys adding them to hash, so we have Param to use in `func` */
+    do {
+        int retry = 0;
+    retry:
+        rc = conn_rc(gsu_ext->conn);
+
+        if (rc)
+            reply = redisCommand(rc, "%s %b %llu COUNT %d", scan_cmd, main_key, (size_t) main_key_len,
+                                 cursor, gsu_ext->opts.batch_size);
+
+        /* Disconnect detection */
+        if (!rc || rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF)) {
+            if (reply)
+                freeReplyObject(reply);
+            reply = NULL;
+            if (retry) {
+                zwarn("Aborting (not connected)");
+                break;
+            }
+            retry = 1;
+            if(conn_reconnect(gsu_ext->conn))
+                // The same cursor
+                goto retry;
+            else
+                break;
+        }
+
+        if (reply == NULL || reply->type != REDIS_REPLY_ARRAY || reply->elements != 2) {
+            if (reply && reply->type == REDIS_REPLY_ERROR) {
+                zwarn("Aborting, problem occured during %s: %s", scan_cmd, reply->str);
+            } else {
+                zwarn("Problem occured during %s, no error message available, aborting", scan_cmd);
+            }
+            if (reply)
+                freeReplyObject(reply);
+            break;
+        }
+
+        /* Get new cursor */
+        if (reply->element[0]->type == REDIS_REPLY_STRING) {
+            cursor = strtoull(reply->element[0]->str, NULL, 10);
+        } else {
+            zwarn("Error 2 occured during %s", scan_cmd);
+            freeReplyObject(reply);
+            break;
+        }
+
+        reply2 = reply->element[1];
+        if (reply2 == NULL || reply2->type != REDIS_REPLY_ARRAY) {
+            zwarn("Error 3 occured during %s", scan_cmd);
+            freeReplyObject(reply);
+            break;
+        }
+
+        visit_pairs(ht, reply2, getnode, func, flags);
+        freeReplyObject(reply);
+    } while (cursor != 0);
+}
+/* }}} */
+/* FUNCTION: fetch_key {{{ */
+
+/*
+ * Single round trip read of a key (GET, SMEMBERS, LRANGE).
+ * There's no EXISTS pre-check: nil reply, empty array and
+ * error (e.g. WRONGTYPE) mean the same – missing key, NULL
+ * is returned. Reconnects once on connection loss.
+ */
+
+static redisReply *
+fetch_key(struct redis_conn *conn, const char *format, const char *key, size_t key_len)
+{
+    redisContext **rc = &conn->rc;
+    redisReply *reply = NULL;
+    int retry = 0;
+
+    /* Own connection in forked child */
+    conn_rc(conn);
+
+ retry:
+    if (*rc) {
+        reply = redisCommand(*rc, format, key, (size_t) key_len);
+        if (reply && (reply->type == REDIS_REPLY_STRING ||
+                      (reply->type == REDIS_REPLY_ARRAY && reply->elements > 0)))
+        {
+            /* Found data: EXISTS + read would be two round trips */
+            zredis_saved_rtt ++;
+            return reply;
+        }
+        if (reply) {
+            freeReplyObject(reply);
+            return NULL;
+        }
+    }
+
+    if (!retry && (!*rc || ((*rc)->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
+        retry = 1;
+        if (conn_reconnect(conn))
+            goto retry;
+    } else if (retry && (!*rc || ((*rc)->err & (REDIS_ERR_IO | REDIS_ERR_EOF)))) {
+        zwarn("Aborting (no connection)");
+    }
+
+    return NULL;
+}
+/* }}} */
+/* FUNCTION: scan_string_keys {{{ */
+
+/*
+ * Fetches one SCAN page of string keys. Uses server-side
+ * type filter (SCAN ... TYPE string, Redis >= 6.0) and on
+ * older servers filters the page with a pipelined batch of
+ * TYPE commands – non-string entries are then freed and set
+ * to NULL (unless `filter` is 0, then caller checks types
+ * itself, e.g. in the purge script). `pending` replies of commands appended earlier
+ * are read first, so that they share the round trip.
+ *
+ * Returns array reply [ cursor, [ keys ] ], updates cursor.
+ * On failure returns NULL, `rc->err` tells if disconnected.
+ */
+
+static redisReply *
+scan_string_keys(redisContext *rc, unsigned long long *cursor, int count,
+                 int *scan_type, int filter, int pending, const char *pending_cmd)
+{
+    redisReply *reply = NULL, *keys, *treply;
+    size_t j;
+    int appended;
+
+    if (*scan_type >= 0)
+        redisAppendCommand(rc, "SCAN %llu COUNT %d TYPE string", *cursor, count);
+    else
+        redisAppendCommand(rc, "SCAN %llu COUNT %d", *cursor, count);
+
+    drain_replies(rc, pending, pending_cmd);
+
+    if (REDIS_OK != redisGetReply(rc, (void **) &reply))
+        reply = NULL;
+
+    /* Server without TYPE option of SCAN? */
+    if (reply && reply->type == REDIS_REPLY_ERROR && *scan_type == 0) {
+        freeReplyObject(reply);
+        reply = NULL;
+        *scan_type = -1;
+        reply = redisCommand(rc, "SCAN %llu COUNT %d", *cursor, count);
+    }
+
+    if (reply == NULL || reply->type != REDIS_REPLY_ARRAY || reply->elements != 2 ||
+        reply->element[0]->type != REDIS_REPLY_STRING || reply->element[1]->type != REDIS_REPLY_ARRAY)
+    {
+        if (reply && reply->type == REDIS_REPLY_ERROR) {
+            zwarn("Aborting, problem occured during SCAN: %s", reply->str);
+        } else if (!(rc->err & (REDIS_ERR_IO | REDIS_ERR_EOF))) {
+            zwarn("Incorrect reply from redis command SCAN, aborting");
+        }
+        if (reply)
+            freeReplyObject(reply);
+        return NULL;
+    }
+
+    if (*scan_type == 0)
+        *scan_type = 1;
+
+    /* Get new cursor */
+    *cursor = strtoull(reply->element[0]->str, NULL, 10);
+
+    if (*scan_type > 0 || !filter)
+        return reply;
+
+    /* Fallback: one pipelined round of TYPE commands */
+    keys = reply->element[1];
+    appended = 0;
+    for (j = 0; j < keys->elements; j++) {
+        if (keys->element[j] && keys->element[j]->type == REDIS_REPLY_STRING) {
+            redisAppendCommand(rc, "TYPE %b", keys->element[j]->str, (size_t) keys->element[j]->len);
+            appended ++;
+        }
+    }
+
+    for (j = 0; j < keys->elements && appended; j++) {
+        if (keys->element[j] == NULL || keys->element[j]->type != REDIS_REPLY_STRING)
+            continue;
+
+        appended --;
+        treply = NULL;
+        if (REDIS_OK != redisGetReply(rc, (void **) &treply)) {
+            freeReplyObject(reply);
+            return NULL;
+        }
+
+        /* Only string keys, ignore the rest (hashes, sets, etc.) */
+        if (treply == NULL || treply->type != REDIS_REPLY_STATUS ||
+            DB_KEY_TYPE_STRING != type_from_string(treply->str, treply->len))
+        {
+            freeReplyObject(keys->element[j]);
+            keys->element[j] = NULL;
+        }
+
+        if (treply)
+            freeReplyObject(treply);
+    }
+
+    return reply;
+}
+/* }}} */
+/* FUNCTION: hash_to_args {{{ */
+
+/*
+ * Flattens hash into heap-allocated, NULL-terminated array
+ * of metafied key, value pairs (value, key when `zset` is
+ * set – ZADD takes score first). Elements that aren't valid
+ * scores are skipped with a warning, as a single bad score
+ * would fail whole variadic ZADD
+ */
+
+/**/
+static char **
+hash_to_args(HashTable ht, int zset)
+{
+    char **args, **ptr;
+    HashNode hn;
+    int i;
+
+    args = ptr = (char **) zhalloc((2 * ht->ct + 1) * sizeof(char *));
+
+    for (i = 0; i < ht->hsize; i++) {
+        for (hn = ht->nodes[i]; hn; hn = hn->next) {
+            struct value v;
+            char *val;
+
+            v.isarr = v.flags = v.start = 0;
+            v.end = -1;
+            v.arr = NULL;
+            v.pm = (Param) hn;
+
+            val = getstrvalue(&v);
+            if (zset) {
+                char *end = NULL;
+                double score = strtod(val, &end);
+                if (!*val || !end || *end || score != score) {
+                    zwarn("Not a valid score for `%s': %s, element skipped", hn->nam, val);
+                    continue;
+                }
+                *ptr++ = val;
+                *ptr++ = hn->nam;
+            } else {
+                *ptr++ = hn->nam;
+                *ptr++ = val;
+            }
+        }
+    }
+    *ptr = NULL;
+
+    return args;
+}
+/* }}} */
+/* FUNCTION: hash_delta {{{ */
+
+/*
+ * Computes difference between cached hash `old` and
+ * new contents `ht`: names of fields to remove and
+ * pairs of fields to set (new, changed or not cached).
+ * Both arrays are heap-allocated and NULL-terminated
+ */
+
+/**/
+static void
+hash_delta(HashTable old, HashTable ht, char ***dels, char ***adds)
+{
+    char **dptr, **aptr, **args;
+    HashNode hn;
+    int i;
+
+    *dels = dptr = (char **) zhalloc((old->ct + 1) * sizeof(char *));
+    *adds = aptr = (char **) zhalloc((2 * ht->ct + 1) * sizeof(char *));
+
+    for (i = 0; i < old->hsize; i++) {
+        for (hn = old->nodes[i]; hn; hn = hn->next) {
+            if (!gethashnode2(ht, hn->nam))
+                *dptr++ = hn->nam;
+        }
+    }
+    *dptr = NULL;
+
+    for (args = hash_to_args(ht, 0); *args; args += 2) {
+        Param opm = (Param) gethashnode2(old, args[0]);
+        if (opm && (opm->node.flags & PM_UPTODATE) && opm->u.str &&
+            0 == strcmp(opm->u.str, args[1]))
+        {
+            continue;
+        }
+        *aptr++ = args[0];
+        *aptr++ = args[1];
+    }
+    *aptr = NULL;
+}
+/* }}} */
+/* FUNCTION: strptrcmp {{{ */
+
+/**/
+static int
+strptrcmp(const void *a, const void *b)
+{
+    return strcmp(*(char **) a, *(char **) b);
+}
+/* }}} */
+/* FUNCTION: array_delta {{{ */
+
+/*
+ * Computes difference between (unique) elements of cached
+ * array `old` and new array `arr` – elements to remove and
+ * to add. Both results are heap-allocated, NULL-terminated,
+ * removed elements are copied, as `old` will be freed
+ */
+
+/**/
+static void
+array_delta(char **old, char **arr, char ***dels, char ***adds)
+{
+    char **so, **sn, **dptr, **aptr;
+    int olen = arrlen(old), nlen = arrlen(arr), i = 0, j = 0, cmp;
+
+    so = (char **) zhalloc((olen + 1) * sizeof(char *));
+    sn = (char **) zhalloc((nlen + 1) * sizeof(char *));
+    memcpy(so, old, olen * sizeof(char *));
+    memcpy(sn, arr, nlen * sizeof(char *));
+    qsort(so, olen, sizeof(char *), strptrcmp);
+    qsort(sn, nlen, sizeof(char *), strptrcmp);
+
+    *dels = dptr = (char **) zhalloc((olen + 1) * sizeof(char *));
+    *adds = aptr = (char **) zhalloc((nlen + 1) * sizeof(char *));
+
+    /* Merge of the two sorted arrays */
+    while (i < olen || j < nlen) {
+        if (i == olen)
+            cmp = 1;
+        else if (j == nlen)
+            cmp = -1;
+        else
+            cmp = strcmp(so[i], sn[j]);
+
+        if (cmp < 0) {
+            *dptr++ = dupstring(so[i++]);
+        } else if (cmp > 0) {
+            *aptr++ = sn[j++];
+        } else {
+            i++;
+            j++;
+        }
+    }
+    *dptr = NULL;
+    *aptr = NULL;
+}
+/* }}} */
+/* FUNCTION: list_delta {{{ */
+
+/*
+ * Checks if new array `arr` is the cached `old` plus
+ * elements appended or prepended. Returns "RPUSH" or
+ * "LPUSH" and sets `adds` to the elements to push (in
+ * pushing order, i.e. reversed for LPUSH), or NULL if
+ * the list is to be fully rewritten
+ */
+
+/**/
+static const char *
+list_delta(char **old, char **arr, char ***adds)
+{
+    int olen = arrlen(old), nlen = arrlen(arr), i;
+
+    if (olen == 0 || nlen <= olen)
+        return NULL;
+
+    /* Append */
+    for (i = 0; i < olen; i++) {
+        if (strcmp(old[i], arr[i]) != 0)
+            break;
+    }
+    if (i == olen) {
+        *adds = arr + olen;
+        return "RPUSH";
+    }
+
+    /* Prepend */
+    for (i = 0; i < olen; i++) {
+        if (strcmp(old[i], arr[nlen - olen + i]) != 0)
+            return NULL;
+    }
+
+    *adds = (char **) zhalloc((nlen - olen + 1) * sizeof(char *));
+    for (i = 0; i < nlen - olen; i++)
+        (*adds)[i] = arr[nlen - olen - 1 - i];
+    (*adds)[nlen - olen] = NULL;
+
+    return "LPUSH";
 }
 /* }}} */
 /* FUNCTION: zrfreearray {{{ */